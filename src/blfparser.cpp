@@ -1,10 +1,14 @@
 #include <QFile>
-#include <array>
+#include <QtEndian>
+#include <QByteArrayView>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <QString>
+#include <QtConcurrent>
 #include "blfparser.h"
 
 constexpr uint8_t signatureSize = 4;
-constexpr uint8_t timeSize = 8;
 constexpr uint8_t headerDataSize = 72;
 constexpr uint8_t objHeaderSize = 16;
 constexpr uint8_t containerHeaderSize = 16;
@@ -16,229 +20,318 @@ constexpr uint8_t canMsg2 = 86;
 constexpr uint8_t canErrExt = 73;
 constexpr uint8_t canFd = 100;
 constexpr uint8_t canFd64 = 101;
+constexpr uint8_t canMsgSize = 16;
+constexpr uint8_t canObjSize = 48;
+constexpr uint8_t minCompressedFrameSize = 4;
 
-QDateTime BlfParser::getDateTime(QDataStream &stream)
+// File header offsets
+constexpr uint8_t headerSizeOfs = 4;
+constexpr uint8_t uncompressSizeOfs = 24;
+constexpr uint8_t countObjOfs = 32;
+// Object header offsets
+constexpr uint8_t headerVersionOfs = 6;
+constexpr uint8_t objSizeOfs = 8;
+constexpr uint8_t objTypeOfs = 12;
+// Container header offsets
+constexpr uint8_t methodOfs = 0;
+constexpr uint8_t containerSizeOfs = 8;
+
+static const char objSignature[] = "LOBJ";
+
+template<typename T>
+static T readLe(const uchar *raw)
+{
+    return qFromLittleEndian<T>(raw);
+}
+
+static qsizetype findObject(const uchar *bytes, qsizetype size, qsizetype from)
+{
+    return QByteArrayView(bytes, size)
+            .indexOf(QByteArrayView(objSignature, signatureSize), from);
+}
+
+
+/* Keep a signature cut by the end of the container */
+static QByteArray cutSignature(const uchar *bytes, qsizetype size,
+                               qsizetype pos)
 {
-    std::array<quint16, timeSize> raw{};
-    for (auto &r : raw) {
-        stream >> r;
+    for (qsizetype len = signatureSize - 1; len > 0; len--) {
+        if ((size - pos >= len)
+            && (std::memcmp(bytes + size - len, objSignature, len) == 0)) {
+            return { reinterpret_cast<const char *>(bytes + size - len), len };
+        }
     }
-    return { QDate(raw[0], raw[1], raw[3]),
-             QTime(raw[4], raw[5], raw[6], raw[7]) };
+    return {};
 }
 
-int BlfParser::parseObject(const QByteArray &bytes,
-                           QVector<CanLogMsg> &messages, QByteArray &remain)
+qsizetype BlfParser::parseObject(const uchar *bytes, qsizetype size,
+                                 QVector<CanLogMsg> &messages)
 {
-    auto index = bytes.indexOf("LOBJ");
-    if (bytes.size() < 16) {
-        // Not enough data to parse, continue at the next object
-        remain = bytes;
-        return bytes.size();
-    }
-    if (index == -1) {
-        qInfo() << "LOBJ not found 1";
+    auto sigSize = std::min<qsizetype>(size, signatureSize);
+    if (std::memcmp(bytes, objSignature, sigSize) != 0) {
+        return -1;
+    }
+    if (size < objHeaderSize) {
+        // Not enough data to parse, continue at the next container
+        return 0;
+    }
+    auto headerVersion = readLe<quint16>(bytes + headerVersionOfs);
+    auto objSize = readLe<quint32>(bytes + objSizeOfs);
+    auto objType = readLe<quint32>(bytes + objTypeOfs);
+    if (objSize < objHeaderSize) {
         return -1;
     }
+    if (objSize > size) {
+        return 0;
+    }
 
-    QDataStream in(bytes);
-    in.setByteOrder(QDataStream::LittleEndian);
-    in.skipRawData(index + 4);
-
-    qint16 headerSize = 0;
-    in >> headerSize;
-    qint16 headerVersion = 0;
-    in >> headerVersion;
-    quint32 objSize = 0;
-    in >> objSize;
-    quint32 objType = 0;
-    in >> objType;
-    auto nextPos = index + objSize;
-    if (nextPos > bytes.size()) {
-        // TODO: What is happening
-        remain = bytes;
-        return bytes.size();
-        // return -1;
-    } else {
-        remain = {};
-    }
-
-    quint32 flags = 0;
-    in >> flags;
-    if (headerVersion == 1) {
-        quint16 dummy = 0;
-        in >> dummy; // Client index
-        in >> dummy; // Object version
-    } else if (headerVersion == 2) {
-        quint8 dummy8 = 0;
-        in >> dummy8; // Timestamp status
-        in >> dummy8; // reserved
-        quint16 dummy16 = 0;
-        in >> dummy16; // Object version
-    }
-    quint64 timestamp = 0;
-    in >> timestamp;
+    qsizetype pos = objHeaderSize;
+    auto flags = readLe<quint32>(bytes + pos);
+    pos += sizeof(quint32);
+    if ((headerVersion == 1) || (headerVersion == 2)) {
+        // v1: client index, object version
+        // v2: timestamp status, reserved, object version
+        pos += sizeof(quint32);
+    }
+    auto timestamp = readLe<quint64>(bytes + pos);
+    pos += sizeof(quint64);
     if (headerVersion == 2) {
-        quint8 dummy = 0;
-        for (int i = 0; i < 8; i++) {
-            in >> dummy;
-        }
+        pos += sizeof(quint64); // Original timestamp
     }
 
-    auto factor = (flags == 1) ? 1e-5 : 1e-9;
-    if ((objType == canMsg) || (objType == canMsg2)) {
+    if (((objType == canMsg) || (objType == canMsg2))
+        && (pos + canMsgSize <= objSize)) {
+        auto factor = (flags == 1) ? 1e-5 : 1e-9;
         CanLogMsg msg;
-        msg.number = counter++;
         msg.time = factor * timestamp;
-        quint16 channel = 0;
-        in >> channel;
-        msg.channel = channel;
-        quint8 flags = 0;
-        in >> flags;
-        quint8 dlc = 0;
-        in >> dlc;
-        msg.dlc = dlc;
-        quint32 id = 0;
-        in >> id;
-        msg.id = id & 0x1FFFFFFF;
-        in.readRawData((char *)msg.data.data(), 8);
+        msg.channel = readLe<quint16>(bytes + pos);
+        msg.dlc = bytes[pos + 3];
+        msg.id = readLe<quint32>(bytes + pos + 4) & 0x1FFFFFFF;
+        std::memcpy(msg.data.data(), bytes + pos + 8, CAN_MAX_DLC);
         messages.append(msg);
     }
-    index = bytes.indexOf("LOBJ", nextPos);
-    if (index >= 0) {
-        return index;
-    } else {
-        return nextPos + (nextPos % 4);
-    }
+    return std::min<qsizetype>(objSize + (objSize % 4), size);
 }
 
-int BlfParser::getObject(QDataStream &in, QVector<CanLogMsg> &messages,
-                         QByteArray &remain)
+qsizetype BlfParser::completeRemain(QByteArray &remain, const uchar *bytes,
+                                    qsizetype size,
+                                    QVector<CanLogMsg> &messages)
 {
-    // 0
-    QByteArray raw(signatureSize, '\0');
-    in.readRawData(raw.data(), signatureSize);
-    if (std::strncmp(raw, "LOBJ", signatureSize) != 0) {
-        return -1;
+    qsizetype used = 0;
+    if (remain.size() < objHeaderSize) {
+        used = std::min<qsizetype>(objHeaderSize - remain.size(), size);
+        remain.append(reinterpret_cast<const char *>(bytes), used);
+        if (remain.size() < objHeaderSize) {
+            return used;
+        }
     }
-    quint16 dummy = 0;
-    in >> dummy;
-    in >> dummy;
-    quint32 objSize = 0;
-    in >> objSize;
-    quint32 objType = 0;
-    in >> objType;
-    auto dataSize = objSize - objHeaderSize;
-    QByteArray objData(dataSize, '\0');
-    in.readRawData(objData.data(), dataSize);
-    in.skipRawData(dataSize % 4); // Skip padding
-    if (objType != logContainer)
+    auto *head = reinterpret_cast<const uchar *>(remain.constData());
+    auto objSize = readLe<quint32>(head + objSizeOfs);
+    if ((std::memcmp(head, objSignature, signatureSize) != 0)
+        || (objSize < objHeaderSize)) {
+        // Not an object head, search this container from its start
+        remain.clear();
         return 0;
+    }
+    auto take = std::min<qsizetype>(objSize - remain.size(), size - used);
+    remain.append(reinterpret_cast<const char *>(bytes + used), take);
+    used += take;
+    if (remain.size() < objSize) {
+        return used;
+    }
+    parseObject(reinterpret_cast<const uchar *>(remain.constData()),
+                remain.size(), messages);
+    remain.clear();
+    return std::min<qsizetype>(used + (objSize % 4), size);
+}
 
-    QDataStream data(objData);
-    data.setByteOrder(QDataStream::LittleEndian);
-    quint16 method = 0;
-    data >> method;
-    quint8 dummy8 = 0;
-    for (int i = 0; i < 6; i++) {
-        data >> dummy8;
-    }
-    quint32 uncompressSize = 0;
-    data >> uncompressSize;
-    objData.remove(0, containerHeaderSize);
-    bool needParse = true;
-    QByteArray containerData;
-    if (method == noCompress) {
-        containerData = objData;
-    } else if (method == zlibDeflate) {
-        std::array<char, 4> zlibHeader{};
-        zlibHeader[0] = (uncompressSize >> 24) & 0xFF;
-        zlibHeader[1] = (uncompressSize >> 16) & 0xFF;
-        zlibHeader[2] = (uncompressSize >> 8) & 0xFF;
-        zlibHeader[3] = (uncompressSize)&0xFF;
-        objData.prepend(zlibHeader.data(), 4);
-        containerData = qUncompress(objData);
-    } else {
-        needParse = false;
-    }
-    if (needParse) {
-        while (containerData.size() != 0) {
-            if (remain.size() != 0) {
-                containerData.prepend(remain);
-            }
-            auto ret = parseObject(containerData, messages, remain);
-            if (ret > 0) {
-                containerData.remove(0, ret);
-            } else {
-                break;
+void BlfParser::parseContainer(QByteArray &remain, const uchar *bytes,
+                               qsizetype size, qsizetype pos,
+                               QVector<CanLogMsg> &messages)
+{
+    while (pos < size) {
+        auto ret = parseObject(bytes + pos, size - pos, messages);
+        if (ret > 0) {
+            pos += ret;
+            continue;
+        }
+        if (ret == 0) {
+            // The object continues in the next container
+            remain = QByteArray(reinterpret_cast<const char *>(bytes + pos),
+                                size - pos);
+            return;
+        }
+        auto next = findObject(bytes, size, pos + 1);
+        if (next < 0) {
+            remain = cutSignature(bytes, size, pos + 1);
+            return;
+        }
+        pos = next;
+    }
+}
+
+QVector<BlfParser::Container> BlfParser::scanContainers(const uchar *file,
+                                                        qsizetype pos,
+                                                        qsizetype fileSize)
+{
+    QVector<Container> containers{};
+    while (fileSize - pos >= objHeaderSize) {
+        const auto *obj = file + pos;
+        if (std::memcmp(obj, objSignature, signatureSize) != 0) {
+            break;
+        }
+        auto objSize = readLe<quint32>(obj + objSizeOfs);
+        auto objType = readLe<quint32>(obj + objTypeOfs);
+        if ((objSize < objHeaderSize) || (objSize > fileSize - pos)) {
+            break;
+        }
+        auto dataSize = objSize - objHeaderSize;
+        if ((objType == logContainer) && (dataSize >= containerHeaderSize)) {
+            const auto *container = obj + objHeaderSize;
+            auto method = readLe<quint16>(container + methodOfs);
+            if ((method == noCompress) || (method == zlibDeflate)) {
+                containers.append(
+                        { pos + objHeaderSize + containerHeaderSize,
+                          dataSize - containerHeaderSize, method,
+                          readLe<quint32>(container + containerSizeOfs) });
             }
         }
+        pos += objSize + (dataSize % 4); // Skip padding
+    }
+    return containers;
+}
+
+QByteArray BlfParser::inflate(uchar *file, const Container &container)
+{
+    auto *payload = file + container.offset;
+    if (container.method == noCompress) {
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(payload),
+                                       container.size);
+    }
+    /* qUncompress wants the expected size as a 4 byte big endian prefix.
+     * The last 4 bytes of the container header are reserved, write the prefix
+     * there instead of copying the payload behind a new header. */
+    qToBigEndian<quint32>(container.uncompressSize,
+                          payload - sizeof(quint32));
+    return qUncompress(payload - sizeof(quint32),
+                       container.size + sizeof(quint32));
+}
+
+BlfParser::Batch BlfParser::parseBatch(uchar *file, const Container &container)
+{
+    Batch batch{ container, {}, {}, {}, false };
+    auto data = inflate(file, container);
+    const auto *bytes = reinterpret_cast<const uchar *>(data.constData());
+    auto size = data.size();
+    /* Bytes before the first signature belong to an object started in an
+     * earlier container, they are stitched in by merge() */
+    auto first = findObject(bytes, size, 0);
+    batch.found = (first >= 0);
+    if (!batch.found) {
+        batch.head = QByteArray(data.constData(), size);
+        batch.tail = cutSignature(bytes, size, 0);
+        return batch;
+    }
+    batch.head = QByteArray(data.constData(), first);
+    parseContainer(batch.tail, bytes, size, first, batch.messages);
+    return batch;
+}
+
+static void appendNumbered(FrameStore &store,
+                           const QVector<CanLogMsg> &messages)
+{
+    for (auto msg : messages) {
+        msg.number = static_cast<uint32_t>(store.size());
+        store.append(msg);
     }
-    return 0;
 }
 
-QVector<CanLogMsg> BlfParser::parse(const QString &name)
+void BlfParser::merge(uchar *file, MergeState &state, const Batch &batch)
 {
+    auto carry = state.remain;
     QVector<CanLogMsg> messages{};
+    const auto *head = reinterpret_cast<const uchar *>(batch.head.constData());
+    qsizetype used = 0;
+    if (!state.remain.isEmpty()) {
+        used = completeRemain(state.remain, head, batch.head.size(), messages);
+    }
+    if (state.remain.isEmpty()) {
+        appendNumbered(state.messages, messages);
+        appendNumbered(state.messages, batch.messages);
+        if (batch.found
+            || (used <= batch.head.size() - batch.tail.size())) {
+            state.remain = batch.tail;
+        }
+        return;
+    }
+    if (!batch.found) {
+        // Still inside an object spanning more than two containers
+        return;
+    }
+
+    /* The signature the worker started from lies inside the straddling
+     * object, parse this container again from the real object border */
+    messages.clear();
+    state.remain = carry;
+    auto data = inflate(file, batch.container);
+    const auto *bytes = reinterpret_cast<const uchar *>(data.constData());
+    auto pos = completeRemain(state.remain, bytes, data.size(), messages);
+    if (state.remain.isEmpty()) {
+        parseContainer(state.remain, bytes, data.size(), pos, messages);
+    }
+    appendNumbered(state.messages, messages);
+}
+
+FrameStore BlfParser::parse(const QString &name)
+{
     QFile file(name);
     if (!file.open(QFile::ReadOnly)) {
         throw std::runtime_error("Cannot open file");
     }
 
-    QDataStream in(&file);
-    in.setByteOrder(QDataStream::LittleEndian);
+    /* Copy-on-write mapping, objects are walked in place and only the pages
+     * holding a zlib prefix get copied */
+    qsizetype fileSize = file.size();
+    auto *raw = file.map(0, fileSize, QFileDevice::MapPrivateOption);
+    QByteArray fallback{};
+    if (raw == nullptr) {
+        fallback = file.readAll();
+        raw = reinterpret_cast<uchar *>(fallback.data());
+        fileSize = fallback.size();
+    }
 
-    // 0
-    char raw[signatureSize];
-    in.readRawData(raw, signatureSize);
-    if (std::strncmp(raw, "LOGG", signatureSize) != 0) {
+    if ((fileSize < headerDataSize)
+        || (std::strncmp(reinterpret_cast<const char *>(raw), "LOGG",
+                         signatureSize)
+            != 0)) {
         throw std::runtime_error("Unexpected format");
     }
-    // 1 - 4
-    quint32 headerSize = 0;
-    in >> headerSize;
-    quint8 dummy = 0;
-    // 2 - 8 - app id
-    in >> dummy;
-    // 3 - 9 - app major
-    in >> dummy;
-    // 4 - 10 - app minor
-    in >> dummy;
-    // 5 - 11 - app build
-    in >> dummy;
-    // 6 - 12 - log major
-    in >> dummy;
-    // 7 - 13 - log minor
-    in >> dummy;
-    // 8 - 14 - log build
-    in >> dummy;
-    // 9 - 15 - log patch
-    in >> dummy;
-    // 10 - 16 - file size
-    quint64 fileSize = 0;
-    in >> fileSize;
-    // 11 - 24 - uncompress size
-    quint64 uncompressSize = 0;
-    in >> uncompressSize;
-    // 12 - 32
-    quint32 countObj = 0;
-    in >> countObj;
-    // 13 - 36
-    quint32 countObjRead = 0;
-    in >> countObjRead;
-    // 14 - 40
-    auto startTime = getDateTime(in);
-    // 15 - 56
-    auto stopTime = getDateTime(in);
-    // 16 - 72 - skipp other data
-    in.skipRawData(static_cast<int>(headerSize - headerDataSize));
-
-    QByteArray remain{};
-    while (!in.atEnd()) {
-        auto ret = getObject(in, messages, remain);
-        if (ret != 0)
-            break;
+    qsizetype headerSize = readLe<quint32>(raw + headerSizeOfs);
+    auto uncompressSize = readLe<quint64>(raw + uncompressSizeOfs);
+    auto countObj = readLe<quint32>(raw + countObjOfs);
+
+    /* Files that were not closed cleanly have no object count, estimate it
+     * from the uncompressed size instead */
+    qsizetype expected = countObj;
+    if (expected == 0) {
+        expected = static_cast<qsizetype>(uncompressSize / canObjSize);
     }
+    MergeState initial{};
+    initial.messages.reserve(
+            std::min(expected, fileSize / minCompressedFrameSize));
 
-    return std::move(messages);
+    /* Containers are independent deflate streams: inflate and parse them on
+     * the thread pool, then stitch the batches back together in file order */
+    auto containers = scanContainers(raw, headerSize, fileSize);
+    auto state = QtConcurrent::blockingMappedReduced<MergeState>(
+            containers,
+            [raw](const Container &container) {
+                return parseBatch(raw, container);
+            },
+            [raw](MergeState &result, const Batch &batch) {
+                merge(raw, result, batch);
+            },
+            std::move(initial),
+            QtConcurrent::OrderedReduce | QtConcurrent::SequentialReduce);
+    return std::move(state.messages);
 }
@@ -1,16 +1,50 @@
 #pragma once
 #include <QVector>
-#include <QDateTime>
-#include "canmsg.h"
+#include <QByteArray>
+#include "framestore.h"
 
 class BlfParser
 {
 public:
-    QDateTime getDateTime(QDataStream &stream);
-    int parseObject(const QByteArray &in, QVector<CanLogMsg> &messages, QByteArray& remain);
-    int getObject(QDataStream &stream, QVector<CanLogMsg> &messages, QByteArray& remain);
-    QVector<CanLogMsg> parse(const QString &name);
+    FrameStore parse(const QString &name);
 
 private:
-    quint32 counter{ 0 };
+    struct Container
+    {
+        qsizetype offset;
+        qsizetype size;
+        quint16 method;
+        quint32 uncompressSize;
+    };
+
+    /* Frames of one container, plus the bytes that belong to objects
+     * straddling its borders */
+    struct Batch
+    {
+        Container container;
+        QVector<CanLogMsg> messages;
+        QByteArray head;
+        QByteArray tail;
+        bool found;
+    };
+
+    struct MergeState
+    {
+        FrameStore messages;
+        QByteArray remain;
+    };
+
+    static QVector<Container> scanContainers(const uchar *file, qsizetype pos,
+                                             qsizetype fileSize);
+    static QByteArray inflate(uchar *file, const Container &container);
+    static Batch parseBatch(uchar *file, const Container &container);
+    static void merge(uchar *file, MergeState &state, const Batch &batch);
+    static qsizetype parseObject(const uchar *bytes, qsizetype size,
+                                 QVector<CanLogMsg> &messages);
+    static qsizetype completeRemain(QByteArray &remain, const uchar *bytes,
+                                    qsizetype size,
+                                    QVector<CanLogMsg> &messages);
+    static void parseContainer(QByteArray &remain, const uchar *bytes,
+                               qsizetype size, qsizetype pos,
+                               QVector<CanLogMsg> &messages);
 };
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <atomic>
+#include <QMutexLocker>
+#include "blockcache.h"
+
+static std::atomic<qsizetype> limitBytes{ BlockCache::defaultMemoryLimit };
+
+static qsizetype blockBytes()
+{
+    return FrameStore::blockSize * FrameBlock::rowBytes;
+}
+
+BlockCache &BlockCache::instance()
+{
+    static BlockCache cache(defaultMemoryLimit / cacheShare);
+    return cache;
+}
+
+BlockCache &BlockCache::decoded()
+{
+    static BlockCache cache(decodedBlocks * blockBytes());
+    return cache;
+}
+
+qsizetype BlockCache::memoryLimit()
+{
+    return limitBytes;
+}
+
+void BlockCache::setMemoryLimit(qsizetype bytes)
+{
+    limitBytes = bytes;
+    instance().setCapacity(bytes / cacheShare);
+}
+
+qsizetype BlockCache::residentLimit()
+{
+    auto filling = FrameStore::blockSize
+            * (FrameBlock::rowBytes + static_cast<qsizetype>(sizeof(uint32_t)));
+    return std::max<qsizetype>(0, memoryLimit() - instance().capacity()
+                                       - decoded().capacity() - filling);
+}
+
+qsizetype BlockCache::capacity() const
+{
+    QMutexLocker locker(&mutex);
+    return blocks.maxCost();
+}
+
+void BlockCache::setCapacity(qsizetype bytes)
+{
+    QMutexLocker locker(&mutex);
+    blocks.setMaxCost(bytes);
+}
+
+qsizetype BlockCache::size() const
+{
+    QMutexLocker locker(&mutex);
+    return blocks.totalCost();
+}
+
+BlockCache::BlockPtr BlockCache::get(const BlockSource *source,
+                                     qsizetype index,
+                                     const std::function<BlockPtr()> &load)
+{
+    Key key{ source, index };
+    {
+        QMutexLocker locker(&mutex);
+        if (auto *cached = blocks.object(key)) {
+            return *cached;
+        }
+    }
+    // Loaded unlocked so that parallel scans do not queue behind each other
+    auto block = load();
+    QMutexLocker locker(&mutex);
+    if (auto *cached = blocks.object(key)) {
+        return *cached;
+    }
+    blocks.insert(key, new BlockPtr(block), block->bytes());
+    return block;
+}
+
+void BlockCache::remove(const BlockSource *source)
+{
+    QMutexLocker locker(&mutex);
+    const auto keys = blocks.keys();
+    for (const auto &key : keys) {
+        if (key.source == source) {
+            blocks.remove(key);
+        }
+    }
+}
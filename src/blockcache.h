@@ -0,0 +1,65 @@
+#pragma once
+#include <functional>
+#include <QCache>
+#include <QMutex>
+#include "framestore.h"
+
+/* Blocks read back from the non-resident stores (trace cache, spill file),
+ * shared by all of them and bounded in bytes, least recently used out.
+ * Evicted blocks stay alive as long as a scan holds them. */
+class BlockCache
+{
+public:
+    using BlockPtr = FrameStore::BlockPtr;
+    static constexpr qsizetype defaultMemoryLimit = qsizetype(1) << 30;
+    // The cache gets one part in cacheShare of the memory limit
+    static constexpr qsizetype cacheShare = 4;
+    // Blocks the decoded() cache holds
+    static constexpr qsizetype decodedBlocks = 4;
+
+    static BlockCache &instance();
+    /* Blocks decoded from the compressed ones kept in memory. Only a few:
+     * decoding a block again is cheap, and holding many decoded would undo
+     * the compression. */
+    static BlockCache &decoded();
+
+    /* Memory limit set by the user, shared between this cache and the
+     * frames and posting lists the stores keep resident */
+    static qsizetype memoryLimit();
+    static void setMemoryLimit(qsizetype bytes);
+    /* What the stores may keep resident before spilling: the limit less
+     * both caches and the block being filled */
+    static qsizetype residentLimit();
+
+    qsizetype capacity() const;
+    void setCapacity(qsizetype bytes);
+    // Bytes of the blocks held
+    qsizetype size() const;
+    /* Block index of source, from the cache or else from load, which runs
+     * outside the lock */
+    BlockPtr get(const BlockSource *source, qsizetype index,
+                 const std::function<BlockPtr()> &load);
+    /* Drops the blocks of a source that is going away */
+    void remove(const BlockSource *source);
+
+private:
+    explicit BlockCache(qsizetype capacity) : blocks(capacity) { }
+
+    struct Key
+    {
+        const BlockSource *source;
+        qsizetype index;
+
+        bool operator==(const Key &other) const
+        {
+            return (source == other.source) && (index == other.index);
+        }
+    };
+    friend size_t qHash(const Key &key, size_t seed)
+    {
+        return qHashMulti(seed, key.source, key.index);
+    }
+
+    mutable QMutex mutex;
+    QCache<Key, BlockPtr> blocks;
+};
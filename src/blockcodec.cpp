@@ -0,0 +1,300 @@
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <QHash>
+#include "blockcodec.h"
+
+constexpr double ticksPerSecond = 1e9;
+constexpr double secondsPerTick = 1e-9;
+// Beyond this the ticks and their deltas could overflow
+constexpr double maxTickTime = 1e9;
+
+/* Flags byte of a frame: dlc in the low nibble, dir in bits 4-6, bit 7 set
+ * when the raw time follows. A dir field of 7 means dlc and dir did not fit
+ * and follow as plain bytes. */
+constexpr uint8_t timeEscape = 0x80;
+constexpr uint8_t dlcBits = 0x0F;
+constexpr int dirShift = 4;
+constexpr uint8_t maxPackedDir = 6;
+constexpr uint8_t wideDlcDir = 7 << dirShift;
+constexpr uint8_t dirBits = 7 << dirShift;
+
+// Worst cases, for sizing the output once
+constexpr qsizetype maxHeaderBytes = 21;
+constexpr qsizetype maxKeyBytes = 6;
+constexpr qsizetype maxFrameBytes = 40;
+
+/* Ticks are turned back into seconds the way the parsers made them: ASC
+ * text is a correctly rounded decimal, which a division reproduces, while
+ * BLF multiplies its nanoseconds. Each block takes the one that misses
+ * less. */
+enum TimeMode : uint8_t { DivideTicks, MultiplyTicks };
+
+static double fromTicks(quint64 tick, TimeMode mode)
+{
+    auto value = static_cast<double>(static_cast<qint64>(tick));
+    return (mode == DivideTicks) ? value / ticksPerSecond
+                                 : value * secondsPerTick;
+}
+
+// Bitwise, so that -0.0 is not taken for 0.0
+static bool sameTime(double a, double b)
+{
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static bool toTicks(double time, quint64 &tick)
+{
+    if (!(std::abs(time) < maxTickTime)) {
+        return false;
+    }
+    tick = static_cast<quint64>(std::llround(time * ticksPerSecond));
+    return true;
+}
+
+static quint64 zigzag(qint64 value)
+{
+    return (static_cast<quint64>(value) << 1)
+            ^ static_cast<quint64>(value >> 63);
+}
+
+static qint64 unzigzag(quint64 value)
+{
+    return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+}
+
+class Writer
+{
+public:
+    explicit Writer(uchar *pos) : pos(pos) { }
+
+    void byte(uint8_t value) { *pos++ = value; }
+    void varint(quint64 value)
+    {
+        while (value >= 0x80) {
+            *pos++ = static_cast<uchar>(value | 0x80);
+            value >>= 7;
+        }
+        *pos++ = static_cast<uchar>(value);
+    }
+    void raw(const void *data, size_t size)
+    {
+        std::memcpy(pos, data, size);
+        pos += size;
+    }
+    uchar *position() const { return pos; }
+
+private:
+    uchar *pos;
+};
+
+class Reader
+{
+public:
+    Reader(const uchar *pos, const uchar *end) : pos(pos), end(end) { }
+
+    uint8_t byte()
+    {
+        need(1);
+        return *pos++;
+    }
+    quint64 varint()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            auto next = byte();
+            value |= static_cast<quint64>(next & 0x7F) << shift;
+            if ((next & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Corrupt frame block");
+    }
+    void raw(void *data, size_t size)
+    {
+        need(size);
+        std::memcpy(data, pos, size);
+        pos += size;
+    }
+    bool atEnd() const { return pos == end; }
+
+private:
+    void need(size_t size) const
+    {
+        if (static_cast<size_t>(end - pos) < size) {
+            throw std::runtime_error("Corrupt frame block");
+        }
+    }
+
+    const uchar *pos;
+    const uchar *end;
+};
+
+QByteArray BlockCodec::encode(const FrameBlock &block)
+{
+    auto rows = block.size();
+    QHash<quint64, quint32> dictionary{};
+    QVector<quint64> keys{};
+    std::vector<quint32> keyOf(rows);
+    qsizetype divideMisses = 0;
+    qsizetype multiplyMisses = 0;
+    for (qsizetype i = 0; i < rows; i++) {
+        auto key = FrameStore::frameKey(block.channel.at(i), block.id.at(i));
+        auto it = dictionary.constFind(key);
+        if (it == dictionary.cend()) {
+            it = dictionary.insert(key, static_cast<quint32>(keys.size()));
+            keys.append(key);
+        }
+        keyOf[i] = it.value();
+
+        quint64 tick = 0;
+        auto time = block.time.at(i);
+        if (toTicks(time, tick)) {
+            divideMisses +=
+                    sameTime(fromTicks(tick, DivideTicks), time) ? 0 : 1;
+            multiplyMisses +=
+                    sameTime(fromTicks(tick, MultiplyTicks), time) ? 0 : 1;
+        }
+    }
+    auto mode = (multiplyMisses < divideMisses) ? MultiplyTicks : DivideTicks;
+
+    QByteArray out(maxHeaderBytes + (keys.size() * maxKeyBytes)
+                           + (rows * maxFrameBytes),
+                   Qt::Uninitialized);
+    auto *begin = reinterpret_cast<uchar *>(out.data());
+    Writer writer(begin);
+    writer.varint(rows);
+    writer.byte(mode);
+    writer.varint(keys.size());
+    for (auto key : keys) {
+        writer.byte(FrameStore::keyChannel(key));
+        writer.varint(FrameStore::keyId(key));
+    }
+
+    std::vector<CanData> previous(keys.size(), CanData{});
+    qint64 previousNumber = -1;
+    quint64 previousTick = 0;
+    quint64 previousDelta = 0;
+    for (qsizetype i = 0; i < rows; i++) {
+        writer.varint(keyOf[i]);
+        qint64 number = block.number.at(i);
+        writer.varint(zigzag(number - previousNumber - 1));
+        previousNumber = number;
+
+        // Times that cannot be ticks keep the prediction going
+        auto time = block.time.at(i);
+        auto predicted = previousTick + previousDelta;
+        quint64 tick = predicted;
+        auto exact =
+                toTicks(time, tick) && sameTime(fromTicks(tick, mode), time);
+        uint8_t flags = exact ? 0 : timeEscape;
+        auto dlc = block.dlc.at(i);
+        auto dir = block.dir.at(i);
+        if ((dlc <= dlcBits) && (dir <= maxPackedDir)) {
+            writer.byte(flags | static_cast<uint8_t>(dir << dirShift) | dlc);
+        } else {
+            writer.byte(flags | wideDlcDir);
+            writer.byte(dlc);
+            writer.byte(dir);
+        }
+        writer.varint(zigzag(static_cast<qint64>(tick - predicted)));
+        if (!exact) {
+            writer.raw(&time, sizeof(time));
+        }
+        previousDelta = tick - previousTick;
+        previousTick = tick;
+
+        auto &last = previous[keyOf[i]];
+        const auto &data = block.data.at(i);
+        uint8_t mask = 0;
+        for (int b = 0; b < CAN_MAX_DLC; b++) {
+            mask |= (data[b] != last[b]) ? (1 << b) : 0;
+        }
+        writer.byte(mask);
+        for (int b = 0; b < CAN_MAX_DLC; b++) {
+            if ((mask & (1 << b)) != 0) {
+                writer.byte(data[b] ^ last[b]);
+            }
+        }
+        last = data;
+    }
+    out.resize(writer.position() - begin);
+    out.squeeze();
+    return out;
+}
+
+std::shared_ptr<FrameBlock> BlockCodec::decode(const QByteArray &bytes)
+{
+    const auto *begin = reinterpret_cast<const uchar *>(bytes.constData());
+    Reader reader(begin, begin + bytes.size());
+    auto rows = reader.varint();
+    auto mode = static_cast<TimeMode>(reader.byte());
+    auto keyCount = reader.varint();
+    if ((rows > static_cast<quint64>(FrameStore::blockSize))
+        || (keyCount > rows) || (mode > MultiplyTicks)) {
+        throw std::runtime_error("Corrupt frame block");
+    }
+    QVector<quint64> keys(static_cast<qsizetype>(keyCount));
+    for (auto &key : keys) {
+        auto channel = reader.byte();
+        key = FrameStore::frameKey(channel,
+                                   static_cast<uint32_t>(reader.varint()));
+    }
+
+    auto block = std::make_shared<FrameBlock>();
+    auto size = static_cast<qsizetype>(rows);
+    block->time.resize(size);
+    block->id.resize(size);
+    block->number.resize(size);
+    block->channel.resize(size);
+    block->dlc.resize(size);
+    block->dir.resize(size);
+    block->data.resize(size);
+
+    std::vector<CanData> previous(keys.size(), CanData{});
+    qint64 previousNumber = -1;
+    quint64 previousTick = 0;
+    quint64 previousDelta = 0;
+    for (qsizetype i = 0; i < size; i++) {
+        auto index = reader.varint();
+        if (index >= keyCount) {
+            throw std::runtime_error("Corrupt frame block");
+        }
+        block->channel[i] = FrameStore::keyChannel(keys.at(index));
+        block->id[i] = FrameStore::keyId(keys.at(index));
+        previousNumber += unzigzag(reader.varint()) + 1;
+        block->number[i] = static_cast<uint32_t>(previousNumber);
+
+        auto flags = reader.byte();
+        if ((flags & dirBits) == wideDlcDir) {
+            block->dlc[i] = reader.byte();
+            block->dir[i] = reader.byte();
+        } else {
+            block->dlc[i] = flags & dlcBits;
+            block->dir[i] = (flags & dirBits) >> dirShift;
+        }
+        auto tick = previousTick + previousDelta
+                + static_cast<quint64>(unzigzag(reader.varint()));
+        if ((flags & timeEscape) != 0) {
+            reader.raw(&block->time[i], sizeof(double));
+        } else {
+            block->time[i] = fromTicks(tick, mode);
+        }
+        previousDelta = tick - previousTick;
+        previousTick = tick;
+
+        auto &last = previous[index];
+        auto mask = reader.byte();
+        for (int b = 0; b < CAN_MAX_DLC; b++) {
+            if ((mask & (1 << b)) != 0) {
+                last[b] ^= reader.byte();
+            }
+        }
+        block->data[i] = last;
+    }
+    if (!reader.atEnd()) {
+        throw std::runtime_error("Corrupt frame block");
+    }
+    return block;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <memory>
+#include <QByteArray>
+#include "framestore.h"
+
+/* Compact, lossless form of a FrameBlock for keeping full blocks resident at
+ * a third or less of their size. Frames are coded one after the other so a
+ * block decodes in a single sequential pass:
+ *   (channel, id) as an index into a per-block dictionary
+ *   number as the varint difference to the previous number plus one
+ *   time as nanosecond ticks, varint delta of delta, with the raw double
+ *   kept for the few times the ticks do not give back exactly
+ *   dlc and dir in one byte
+ *   payload XOR the previous payload of the same (channel, id), as a byte
+ *   mask followed by the bytes that changed */
+class BlockCodec
+{
+public:
+    static QByteArray encode(const FrameBlock &block);
+    /* Throws std::runtime_error on malformed data */
+    static std::shared_ptr<FrameBlock> decode(const QByteArray &bytes);
+};
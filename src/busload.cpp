@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include <QtConcurrent>
+#include "busload.h"
+
+/* Classic CAN frame layout: the bits from SOF to the CRC are stuffed, a
+ * stuff bit at worst after every four bits past the first. CRC delimiter,
+ * ACK, EOF and the interframe space add 13 unstuffed bits. */
+constexpr int stuffedStandardBits = 34;
+constexpr int stuffedExtendedBits = 54;
+constexpr int unstuffedBits = 13;
+constexpr int bitsPerStuffBit = 4;
+constexpr double percent = 100;
+
+int BusLoad::frameBits(uint32_t id, uint8_t dlc)
+{
+    auto stuffed = ((id > maxNormalCanId) ? stuffedExtendedBits
+                                          : stuffedStandardBits)
+            + 8 * std::min(dlc, CAN_MAX_DLC);
+    return stuffed + ((stuffed - 1) / bitsPerStuffBit) + unstuffedBits;
+}
+
+QMap<uint8_t, SignalGraph> BusLoad::compute(const FrameStore &frames,
+                                            int bitrate, double bucket)
+{
+    QMap<uint8_t, SignalGraph> graphs{};
+    if (frames.isEmpty() || (bitrate <= 0) || !(bucket > 0)) {
+        return graphs;
+    }
+    auto start = frames.startTime();
+    auto span = frames.endTime() - start;
+    if (span / bucket >= static_cast<double>(maxBuckets)) {
+        throw std::runtime_error("Too many buckets, choose a longer bucket");
+    }
+    auto bucketCount = static_cast<qsizetype>(span / bucket) + 1;
+    auto bucketOf = [&](double time) {
+        return std::clamp<qsizetype>(
+                static_cast<qsizetype>(std::floor((time - start) / bucket)), 0,
+                bucketCount - 1);
+    };
+
+    QList<uint8_t> channels{};
+    for (auto key : frames.frameKeys()) {
+        auto channel = FrameStore::keyChannel(key);
+        if (!channels.contains(channel)) {
+            channels.append(channel);
+        }
+    }
+    std::sort(channels.begin(), channels.end());
+    // Dense channel slots, channels are few and small numbers
+    std::array<int, 256> slot{};
+    slot.fill(-1);
+    for (qsizetype i = 0; i < channels.size(); i++) {
+        slot[channels.at(i)] = static_cast<int>(i);
+    }
+
+    /* Every block sums the bits of the buckets it spans, buckets shared
+     * with the next block are added up when merging */
+    struct Partial
+    {
+        qsizetype firstBucket{ 0 };
+        qsizetype bucketCount{ 0 };
+        std::vector<quint64> bits{};
+    };
+    std::vector<Partial> partials(frames.blockCount());
+    QVector<qsizetype> blocks(frames.blockCount());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    auto channelCount = channels.size();
+    QtConcurrent::blockingMap(blocks, [&](qsizetype b) {
+        auto block = frames.block(b);
+        if (block->size() == 0) {
+            return;
+        }
+        auto &partial = partials[b];
+        auto [first, last] = std::minmax_element(block->time.cbegin(),
+                                                 block->time.cend());
+        partial.firstBucket = bucketOf(*first);
+        partial.bucketCount = bucketOf(*last) - partial.firstBucket + 1;
+        partial.bits.assign(partial.bucketCount * channelCount, 0);
+        for (qsizetype i = 0; i < block->size(); i++) {
+            auto index = bucketOf(block->time.at(i)) - partial.firstBucket;
+            partial.bits[index * channelCount + slot[block->channel.at(i)]] +=
+                    frameBits(block->id.at(i), block->dlc.at(i));
+        }
+    });
+
+    std::vector<quint64> bits(bucketCount * channelCount, 0);
+    for (const auto &partial : partials) {
+        auto offset = partial.firstBucket * channelCount;
+        for (std::size_t i = 0; i < partial.bits.size(); i++) {
+            bits[offset + i] += partial.bits[i];
+        }
+    }
+
+    auto capacity = static_cast<double>(bitrate) * bucket;
+    for (qsizetype c = 0; c < channelCount; c++) {
+        SignalGraph graph{};
+        graph.reserve(bucketCount);
+        for (qsizetype b = 0; b < bucketCount; b++) {
+            graph.append({ start + (static_cast<double>(b) * bucket),
+                           static_cast<double>(bits[b * channelCount + c])
+                                   * percent / capacity });
+        }
+        graphs.insert(channels.at(c), graph);
+    }
+    return graphs;
+}
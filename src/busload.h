@@ -0,0 +1,24 @@
+#pragma once
+#include <QMap>
+#include "canmsg.h"
+#include "framestore.h"
+
+/* Bus utilisation of every channel over fixed time buckets */
+class BusLoad
+{
+public:
+    static constexpr int defaultBitrate = 500000;
+    static constexpr qsizetype maxBuckets = qsizetype(1) << 24;
+
+    /* Bits of a classic data frame on the wire, with the worst case number
+     * of stuff bits and the interframe space */
+    static int frameBits(uint32_t id, uint8_t dlc);
+
+    /* Percent of the bus time taken by the frames of each channel, one
+     * point per bucket from the first frame of the trace. A frame counts
+     * in the bucket of its time stamp. Runs on the thread pool one block at
+     * a time; throws std::runtime_error when the trace needs more than
+     * maxBuckets buckets. */
+    static QMap<uint8_t, SignalGraph> compute(const FrameStore &frames,
+                                              int bitrate, double bucket);
+};
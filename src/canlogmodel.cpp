@@ -1,26 +1,185 @@
 #include "canlogmodel.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <QString>
 #include <QColor>
 #include <QBrush>
 
-CanLogModel::CanLogModel(const QVector<CanLogMsg> &buffer, const CanDb &db,
+namespace {
+
+constexpr char hexDigits[] = "0123456789ABCDEF";
+constexpr char decimalPairs[] = "00010203040506070809"
+                                "10111213141516171819"
+                                "20212223242526272829"
+                                "30313233343536373839"
+                                "40414243444546474849"
+                                "50515253545556575859"
+                                "60616263646566676869"
+                                "70717273747576777879"
+                                "80818283848586878889"
+                                "90919293949596979899";
+constexpr int timeDecimals = 4;
+constexpr double timeScale = 1e4;
+constexpr double maxFastTime = 1e9;
+
+/* Writes the digits of value backwards from end, two at a time, and
+ * returns the first one */
+char16_t *writeDecimal(char16_t *end, uint64_t value, int minDigits = 1)
+{
+    auto *out = end;
+    while (value >= 100) {
+        auto pair = (value % 100) * 2;
+        value /= 100;
+        *--out = decimalPairs[pair + 1];
+        *--out = decimalPairs[pair];
+    }
+    if (value >= 10) {
+        *--out = decimalPairs[(value * 2) + 1];
+        *--out = decimalPairs[value * 2];
+    } else {
+        *--out = static_cast<char16_t>('0' + value);
+    }
+    while (end - out < minDigits) {
+        *--out = '0';
+    }
+    return out;
+}
+
+QString formatNumber(uint32_t value)
+{
+    char16_t buffer[16];
+    auto *end = buffer + std::size(buffer);
+    auto *first = writeDecimal(end, value);
+    return QString(reinterpret_cast<const QChar *>(first), end - first);
+}
+
+/* Same text as QString::number(time, 'f', 4), short of rounding of exact
+ * halves */
+QString formatTime(double time)
+{
+    if (!std::isfinite(time) || (std::abs(time) >= maxFastTime)) {
+        return QString::number(time, 'f', timeDecimals);
+    }
+    // The whole part splits off exactly, only the fraction gets scaled
+    auto whole = std::floor(std::abs(time));
+    auto scaled = (static_cast<int64_t>(whole) * static_cast<int64_t>(timeScale))
+            + std::llround((std::abs(time) - whole) * timeScale);
+    char16_t buffer[32];
+    auto *end = buffer + std::size(buffer);
+    auto *first = writeDecimal(end, static_cast<uint64_t>(scaled),
+                               timeDecimals + 1);
+    // Move the whole part one left to make room for the point
+    std::copy(first, end - timeDecimals, first - 1);
+    first--;
+    *(end - timeDecimals - 1) = '.';
+    if (time < 0) {
+        *--first = '-';
+    }
+    return QString(reinterpret_cast<const QChar *>(first), end - first);
+}
+
+QString formatId(uint32_t id)
+{
+    int nibbles = (id > maxNormalCanId) ? extCanNibble : normalCanNibble;
+    QString text(nibbles, Qt::Uninitialized);
+    auto *out = text.data();
+    for (int i = nibbles - 1; i >= 0; i--) {
+        out[i] = QLatin1Char(hexDigits[id & 0xF]);
+        id >>= 4;
+    }
+    return text;
+}
+
+/* " 00 01 ..", three characters per payload byte */
+QString formatPayload(const CanData &data, uint8_t dlc)
+{
+    int count = std::min<int>(dlc, CAN_MAX_DLC);
+    QString text(count * 3, Qt::Uninitialized);
+    auto *out = text.data();
+    for (int i = 0; i < count; i++) {
+        *out++ = QLatin1Char(' ');
+        *out++ = QLatin1Char(hexDigits[data[i] >> 4]);
+        *out++ = QLatin1Char(hexDigits[data[i] & 0xF]);
+    }
+    return text;
+}
+
+} // namespace
+
+CanLogModel::CanLogModel(const FrameStore &buffer, const CanDb &db,
                          QObject *parent)
     : QAbstractItemModel(parent),
-      rowList(QHash<uint32_t, bool>()),
-      idList(QHash<uint32_t, bool>()),
       buffer(buffer),
       db(db)
 {
 }
 
+void CanLogModel::logChanged()
+{
+    beginResetModel();
+    rowHighlight = RowBitmap((buffer.size() + 63) / 64);
+    normalIdHighlight.reset();
+    extIdHighlight.clear();
+    textCache.clear();
+    evaluateRules();
+    endResetModel();
+}
+
+void CanLogModel::dbChanged()
+{
+    beginResetModel();
+    textCache.clear();
+    // Signal names may have come or gone
+    evaluateRules();
+    endResetModel();
+}
+
+void CanLogModel::addHighlightRule(const QString &expression,
+                                   const QColor &color)
+{
+    auto filter = FilterExpr::compile(expression, db);
+    rules.append({ expression, color, filter.evaluate(buffer) });
+    if (buffer.size() > 0) {
+        emit dataChanged(index(0, 0, {}),
+                         index(static_cast<int>(buffer.size()) - 1,
+                               columnCount() - 1, {}),
+                         { Qt::BackgroundRole });
+    }
+}
+
+void CanLogModel::clearHighlightRules()
+{
+    rules.clear();
+    if (buffer.size() > 0) {
+        emit dataChanged(index(0, 0, {}),
+                         index(static_cast<int>(buffer.size()) - 1,
+                               columnCount() - 1, {}),
+                         { Qt::BackgroundRole });
+    }
+}
+
+void CanLogModel::evaluateRules()
+{
+    for (auto &rule : rules) {
+        try {
+            rule.rows = FilterExpr::compile(rule.expression, db)
+                                .evaluate(buffer);
+        } catch (const std::runtime_error &) {
+            // The database lost a signal of the rule, it matches nothing
+            rule.rows = RowBitmap((buffer.size() + 63) / 64);
+        }
+    }
+}
+
 int CanLogModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid()) {
-        if (parent.constInternalPointer() != nullptr) {
+        // Signals hang under the first column of their frame
+        if ((parent.internalId() != 0) || (parent.column() != 0)) {
             return 0;
         }
-        auto log = buffer.at(parent.row());
-        auto msg = db.findMessage(log.id);
+        auto msg = db.findMessage(buffer.id(parent.row()));
         if (msg == nullptr) {
             return 0;
         }
@@ -30,49 +189,65 @@ int CanLogModel::rowCount(const QModelIndex &parent) const
     }
 }
 
+QString CanLogModel::formatFrame(const CanLogMsg &item, const CanMessage *msg,
+                                 int column)
+{
+    switch (column) {
+    case 0:
+        return formatNumber(item.number);
+    case 1:
+        return formatTime(item.time);
+    case 2:
+        return formatNumber(item.channel);
+    case 3:
+        return formatId(item.id);
+    case 4:
+        return formatNumber(item.dlc);
+    case 5:
+        return (msg != nullptr) ? msg->name : QString();
+    case 6:
+        return formatPayload(item.data, item.dlc);
+    default:
+        return {};
+    }
+}
+
+QString CanLogModel::cellText(int row, int column) const
+{
+    if (const auto *text = textCache.object(row)) {
+        return text->at(column);
+    }
+    // Format a window around the row, scrolling either way then hits
+    auto first = std::max(row - (readAhead / 2), 0);
+    auto last = std::min<qsizetype>(first + readAhead, buffer.size());
+    for (auto r = first; r < last; r++) {
+        if (textCache.contains(r)) {
+            continue;
+        }
+        auto item = buffer.at(r);
+        const auto *msg = db.findMessage(item.id);
+        auto *text = new RowText{};
+        for (int c = 0; c < frameColumns; c++) {
+            (*text)[c] = formatFrame(item, msg, c);
+        }
+        textCache.insert(r, text);
+    }
+    return textCache.object(row)->at(column);
+}
+
 QVariant CanLogModel::displayRowData(const QModelIndex &index) const
 {
     QString ret = "";
     const CanMessage *msg = nullptr;
-    if (index.constInternalPointer() == nullptr) {
-        auto item = buffer.at(index.row());
-        msg = db.findMessage(item.id);
-
-        switch (index.column()) {
-        case 0:
-            ret = QString::number(item.number);
-            break;
-        case 1:
-            ret = QString::number(item.time, 'f', 4);
-            break;
-        case 2:
-            ret = QString::number(item.channel);
-            break;
-        case 3:
-            ret = CanMessage::formatId(item.id);
-            break;
-        case 4:
-            ret = QString::number(item.dlc);
-            break;
-        case 5:
-            if (msg != nullptr) {
-                ret = msg->name;
-            }
-            break;
-        case 6:
-            ret = "";
-            for (int i = 0; i < item.dlc; i++) {
-                ret.append(QString(" %1")
-                                   .arg(item.data[i], 2, 16, QLatin1Char('0'))
-                                   .toUpper());
-            }
-            break;
-        default:
+    if (index.internalId() == 0) {
+        if (index.column() >= columnCount()) {
             return {};
         }
+        ret = cellText(index.row(), index.column());
     } else {
-        auto item = static_cast<CanLogMsg *>(index.internalPointer());
-        msg = db.findMessage(item->id);
+        // Signal rows carry the row of their frame, plus one
+        auto item = buffer.at(static_cast<qsizetype>(index.internalId()) - 1);
+        msg = db.findMessage(item.id);
         auto signal = msg->canSignals.at(index.row());
         switch (index.column()) {
         case 0:
@@ -83,10 +258,10 @@ QVariant CanLogModel::displayRowData(const QModelIndex &index) const
             break;
         case 2:
             ret = QString("%1").arg(
-                    CanSignal::parseSignal(signal, item->data, item->dlc));
+                    CanSignal::parseSignal(signal, item.data, item.dlc));
             break;
         case 3:
-            auto value = CanSignal::parseSignal(signal, item->data, item->dlc);
+            auto value = CanSignal::parseSignal(signal, item.data, item.dlc);
             ret = signal.display(value);
             break;
         }
@@ -102,19 +277,23 @@ QVariant CanLogModel::data(const QModelIndex &index, int role) const
     if (index.row() >= buffer.size())
         return {};
 
-    auto msg = buffer.at(index.row());
-
     if (role == Qt::DisplayRole) {
         return displayRowData(index);
     } else if (role == Qt::BackgroundRole) {
-        if (rowList.value(index.row(), false)) {
+        auto id = buffer.id(index.row());
+        if (testRow(rowHighlight, index.row())) {
             auto color = QColor(Qt::yellow);
             return QBrush(color);
-        } else if (idList.value(msg.id, false)) {
+        } else if (isIdHighlighted(id)) {
             auto color = QColor(Qt::green);
             return QBrush(color);
         } else {
-            auto canmsg = db.findMessage(msg.id);
+            for (const auto &rule : rules) {
+                if (testRow(rule.rows, index.row())) {
+                    return QBrush(rule.color);
+                }
+            }
+            auto canmsg = db.findMessage(id);
             if (canmsg != nullptr) {
                 return canmsg->color;
             }
@@ -152,14 +331,32 @@ void CanLogModel::setHighlightMsg(const QModelIndex &index, bool status)
     if (!index.isValid())
         return;
 
-    rowList[index.row()] = status;
+    auto &word = rowHighlight[index.row() >> 6];
+    auto bit = quint64(1) << (index.row() & 63);
+    word = status ? (word | bit) : (word & ~bit);
+    emit dataChanged(index.siblingAtColumn(0),
+                     index.siblingAtColumn(columnCount() - 1),
+                     { Qt::BackgroundRole });
 }
 void CanLogModel::setHighlightId(const QModelIndex &index, bool status)
 {
     if (!index.isValid())
         return;
-    auto msg = buffer.at(index.row());
-    idList[msg.id] = status;
+    auto id = buffer.id(index.row());
+    if (id <= maxNormalCanId) {
+        normalIdHighlight.set(id, status);
+    } else if (status) {
+        extIdHighlight.insert(id);
+    } else {
+        extIdHighlight.remove(id);
+    }
+    // Only the span of rows carrying the id needs a repaint
+    auto rows = buffer.rowsOfId(id);
+    if (!rows.isEmpty()) {
+        emit dataChanged(this->index(rows.first(), 0, {}),
+                         this->index(rows.last(), columnCount() - 1, {}),
+                         { Qt::BackgroundRole });
+    }
 }
 
 bool CanLogModel::isMsgHighlight(const QModelIndex &index)
@@ -167,15 +364,14 @@ bool CanLogModel::isMsgHighlight(const QModelIndex &index)
     if (!index.isValid())
         return false;
 
-    return rowList.value(index.row(), false);
+    return testRow(rowHighlight, index.row());
 }
 
 bool CanLogModel::isIdHighlight(const QModelIndex &index)
 {
     if (!index.isValid())
         return false;
-    auto msg = buffer.at(index.row());
-    return idList.value(msg.id, false);
+    return isIdHighlighted(buffer.id(index.row()));
 }
 
 QModelIndex CanLogModel::index(int row, int column,
@@ -186,13 +382,13 @@ QModelIndex CanLogModel::index(int row, int column,
     }
 
     if (parent.isValid()) {
-        auto *log = &buffer[parent.row()];
-        auto msg = db.findMessage(log->id);
+        auto msg = db.findMessage(buffer.id(parent.row()));
         if (msg == nullptr) {
             return {};
         }
         if (row < msg->signalCount()) {
-            return createIndex(row, column, log);
+            return createIndex(row, column,
+                               static_cast<quintptr>(parent.row()) + 1);
         }
     } else {
         return createIndex(row, column);
@@ -200,7 +396,10 @@ QModelIndex CanLogModel::index(int row, int column,
     return {};
 }
 
-QModelIndex CanLogModel::parent(const QModelIndex &) const
+QModelIndex CanLogModel::parent(const QModelIndex &index) const
 {
-    return {};
+    if (!index.isValid() || (index.internalId() == 0)) {
+        return {};
+    }
+    return createIndex(static_cast<int>(index.internalId() - 1), 0);
 }
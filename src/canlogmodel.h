@@ -1,28 +1,34 @@
 #pragma once
 
+#include <array>
+#include <bitset>
 #include <QSortFilterProxyModel>
+#include <QCache>
+#include <QColor>
 #include <QVector>
-#include <QHash>
+#include <QSet>
 
 #include "canmsg.h"
+#include "filterexpr.h"
+#include "framestore.h"
 
 class CanLogModel : public QAbstractItemModel
 {
     Q_OBJECT
 
 public:
-    CanLogModel(const QVector<CanLogMsg> &buffer, const CanDb &db, QObject *parent = nullptr);
+    CanLogModel(const FrameStore &buffer, const CanDb &db, QObject *parent = nullptr);
 
     int rowCount([[maybe_unused]] const QModelIndex &parent =
                          QModelIndex()) const override;
     int columnCount([[maybe_unused]] const QModelIndex &parent =
                             QModelIndex()) const override
     {
-        return 7;
+        return frameColumns;
     }
     QModelIndex index(int row, int column,
                       const QModelIndex &parent) const override;
-    QModelIndex parent(const QModelIndex &) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation,
                         int role = Qt::DisplayRole) const override;
@@ -30,24 +36,54 @@ public:
     bool isIdHighlight(const QModelIndex &index);
     void setHighlightMsg(const QModelIndex &index, bool status);
     void setHighlightId(const QModelIndex &index, bool status);
+    /* Colours every frame matching a filter expression, evaluated once
+     * over the whole trace. Throws std::runtime_error when the expression
+     * does not compile. Earlier rules win over later ones. */
+    void addHighlightRule(const QString &expression, const QColor &color);
+    void clearHighlightRules();
+    qsizetype highlightRuleCount() const { return rules.size(); }
+    const FrameStore &frames() const { return buffer; }
+    const CanDb &database() const { return db; }
+    /* Text of a frame column, reentrant so filters can run off the GUI
+     * thread */
+    static QString formatFrame(const CanLogMsg &item, const CanMessage *msg,
+                               int column);
 
  public slots:
-    void logChanged() {
-        beginResetModel();
-        rowList.clear();
-        idList.clear();
-        endResetModel();
-    }
-
-    void dbChanged() {
-        beginResetModel();
-        endResetModel();
-    }
+    void logChanged();
+    void dbChanged();
 
 private:
+    static constexpr int frameColumns = 7;
+    /* Rows of text kept for the rows in view, they are painted many times
+     * while scrolling and resizing */
+    static constexpr int cachedRows = 8192;
+    static constexpr int readAhead = 128;
+    using RowText = std::array<QString, frameColumns>;
+
+    struct HighlightRule
+    {
+        QString expression;
+        QColor color;
+        RowBitmap rows;
+    };
+
     QVariant displayRowData(const QModelIndex &index) const;
-    QHash<uint32_t, bool> rowList;
-    QHash<uint32_t, bool> idList;
-    const QVector<CanLogMsg>& buffer;
+    QString cellText(int row, int column) const;
+    bool isIdHighlighted(uint32_t id) const
+    {
+        return (id <= maxNormalCanId) ? normalIdHighlight.test(id)
+                                      : extIdHighlight.contains(id);
+    }
+    void evaluateRules();
+
+    RowBitmap rowHighlight{};
+    /* Direct table for the standard IDs, a set for the sparse extended
+     * ones */
+    std::bitset<maxNormalCanId + 1> normalIdHighlight{};
+    QSet<uint32_t> extIdHighlight{};
+    QVector<HighlightRule> rules{};
+    const FrameStore& buffer;
     const CanDb& db;
+    mutable QCache<int, RowText> textCache{ cachedRows };
 };
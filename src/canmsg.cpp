@@ -1,96 +1,147 @@
+#include <algorithm>
+#include <QtEndian>
 #include "canmsg.h"
+#include "framestore.h"
+#include "signaldecoder.h"
 
 constexpr uint8_t bitsInByte = 8;
 
-double CanSignal::parseSignal(const CanSignal &signal, const CanData &input, uint8_t dlc)
+CanSignal::Plan CanSignal::compilePlan(const CanSignal &signal)
 {
-    auto len = signal.len;
-    auto startBit = signal.startBit;
-    if (((startBit + len) > (dlc * bitsInByte)) || (signal.len == 0)) {
-        return qQNaN();
+    Plan plan{};
+    plan.startBit = signal.startBit;
+    plan.len = signal.len;
+    plan.isBigEndian = signal.isBigEndian;
+    plan.isSigned = signal.isSigned;
+    plan.endBit = signal.startBit + signal.len;
+    if ((signal.len == 0) || (plan.endBit > CAN_MAX_DLC * bitsInByte)) {
+        return plan;
+    }
+    plan.mask = (signal.len == 64) ? UINT64_MAX
+                                   : ((uint64_t(1) << signal.len) - 1);
+    plan.fieldMask = plan.mask << signal.startBit;
+    plan.rawBits = signal.len;
+    plan.byteOfs = signal.startBit / bitsInByte;
+    if (signal.isBigEndian) {
+        /* Every byte the signal touches gives its bits right aligned, the
+         * first byte most significant, as in a Motorola bit walk. A start
+         * bit inside a byte makes the first byte short but still 8 bits
+         * apart from the next one. */
+        auto last = (plan.endBit - 1) / bitsInByte;
+        auto align = signal.startBit % bitsInByte;
+        plan.swapShift = (CAN_MAX_DLC - 1 - last) * bitsInByte;
+        plan.lowBits = (last - plan.byteOfs) * bitsInByte;
+        plan.firstShift = plan.lowBits + align;
+        plan.rawBits = plan.lowBits
+                + std::min<uint8_t>(bitsInByte - align, signal.len);
     }
-    QVector<uint8_t> dataBytes;
-    while (len) {
-        auto remain = startBit % bitsInByte;
-        if (remain == 0) {
-            if (len >= bitsInByte) {
-                dataBytes.append(input.at(startBit / bitsInByte));
-                startBit += bitsInByte;
-                len -= bitsInByte;
-            } else {
-                dataBytes.append(GetNbit(input.at(startBit / bitsInByte), len));
-                len = 0;
-            }
-        } else {
-            auto bit2Get = bitsInByte - remain;
-            if (bit2Get < len) {
-                dataBytes.append(
-                        GetNbit(input.at(startBit / bitsInByte) >> remain, bit2Get));
-                startBit += bit2Get;
-                len -= bit2Get;
-            } else {
-                dataBytes.append(
-                        GetNbit(input.at(startBit / bitsInByte) >> remain, len));
-                len = 0;
-            }
+    plan.kind = Plan::Generic;
+    if ((signal.startBit % bitsInByte) == 0) {
+        switch (signal.len) {
+        case 8:
+            plan.kind = Plan::Byte;
+            break;
+        case 16:
+            plan.kind = Plan::Word;
+            break;
+        case 32:
+            plan.kind = Plan::DWord;
+            break;
+        default:
+            break;
         }
     }
+    return plan;
+}
 
-    uint64_t raw = 0;
-    if (signal.isBigEndian) {
-        for (const uint8_t d : dataBytes) {
-            raw <<= bitsInByte;
-            raw += d;
-        }
-    } else {
-        auto shiftCnt = 0;
-        for (const uint8_t d : dataBytes) {
-            raw += d << shiftCnt;
-            shiftCnt += bitsInByte;
-        }
+static uint64_t extract(const CanSignal::Plan &plan, const CanData &input)
+{
+    const auto *bytes = input.data() + plan.byteOfs;
+    switch (plan.kind) {
+    case CanSignal::Plan::Byte:
+        return *bytes;
+    case CanSignal::Plan::Word:
+        return plan.isBigEndian ? qFromBigEndian<quint16>(bytes)
+                                : qFromLittleEndian<quint16>(bytes);
+    case CanSignal::Plan::DWord:
+        return plan.isBigEndian ? qFromBigEndian<quint32>(bytes)
+                                : qFromLittleEndian<quint32>(bytes);
+    default:
+        break;
     }
-    double ret = 0;
-    if (signal.isSigned) {
-        auto signBit = raw >> (signal.len - 1);
-        if (signBit) {
-            uint64_t mask = UINT64_MAX;
-            if (signal.len != 64) {
-                mask = (((uint64_t)1) << signal.len) - 1;
-            }
-            ret = ((int64_t)(raw - mask - 1));
-        } else {
-            ret = (raw);
-        }
-    } else {
-        ret = static_cast<double>(raw);
+    auto word = qFromLittleEndian<quint64>(input.data());
+    if (!plan.isBigEndian) {
+        return (word >> plan.startBit) & plan.mask;
     }
-    return (ret * signal.scale) + signal.offset;
+    auto raw = qbswap<quint64>(word & plan.fieldMask) >> plan.swapShift;
+    auto low = (plan.lowBits == 0) ? 0
+                                   : raw & ((uint64_t(1) << plan.lowBits) - 1);
+    return low | ((raw >> plan.firstShift) << plan.lowBits);
 }
 
-QVector<QPair<double, double>>
-CanSignal::getSignalGraph(const CanSignal &signal, uint32_t id,
-                          const QVector<CanLogMsg> &log)
+double CanSignal::parseRaw(const Plan &plan, const CanData &input,
+                           uint8_t dlc)
+{
+    if ((plan.kind == Plan::Invalid) || (plan.endBit > dlc * bitsInByte)) {
+        return qQNaN();
+    }
+    auto raw = extract(plan, input);
+    if (plan.isSigned && ((raw >> (plan.len - 1)) != 0)) {
+        return static_cast<int64_t>(raw - plan.mask - 1);
+    }
+    return static_cast<double>(raw);
+}
+
+double CanSignal::parseSignal(const CanSignal &signal, const CanData &input,
+                              uint8_t dlc)
+{
+    // Signals added through a CanMessage come precompiled
+    const auto plan = signal.plan.matches(signal) ? signal.plan
+                                                  : compilePlan(signal);
+    return (parseRaw(plan, input, dlc) * signal.scale) + signal.offset;
+}
+
+SignalGraph CanSignal::getSignalGraph(const CanSignal &signal, uint32_t id,
+                                      const FrameStore &log)
 {
     /* Include first and last timestamp to make sure all graph have the same
      * x-axis range */
-    QVector<QPair<double, double>> ret;
-    auto firstTime = log.at(0).time;
-    auto lastTime = firstTime;
+    SignalGraph ret;
+    if (log.isEmpty()) {
+        return ret;
+    }
+    auto firstTime = log.startTime();
+    auto lastTime = log.endTime();
     double lastValue = 0;
-    auto isFirst = true;
-    for (auto& data : log) {
-        if (data.id == id) {
-            auto value = parseSignal(signal, data.data, data.dlc);
-            if (isFirst) {
-                isFirst = false;
-                ret.append({ firstTime, value });
-            }
-            ret.append({ data.time, value });
-            lastValue = value;
+    // Only the frames carrying the id are visited, one block at a time
+    auto rows = log.rowsOfId(id);
+    ret.reserve(rows.size() + 2);
+    QVector<uint32_t> blockRows{};
+    QVector<double> values{};
+    qsizetype first = 0;
+    while (first < rows.size()) {
+        auto blockIndex = FrameStore::blockOf(rows.at(first));
+        auto start = FrameStore::blockStart(blockIndex);
+        auto block = log.block(blockIndex);
+        blockRows.clear();
+        for (; (first < rows.size())
+             && (FrameStore::blockOf(rows.at(first)) == blockIndex);
+             first++) {
+            blockRows.append(static_cast<uint32_t>(rows.at(first) - start));
+        }
+        values.resize(blockRows.size());
+        SignalDecoder::decode(signal, block->data.constData(),
+                              block->dlc.constData(), blockRows.constData(),
+                              blockRows.size(), values.data());
+        if (ret.isEmpty()) {
+            ret.append({ firstTime, values.first() });
+        }
+        for (qsizetype i = 0; i < blockRows.size(); i++) {
+            ret.append({ block->time.at(blockRows.at(i)), values.at(i) });
         }
-        lastTime = data.time;
+        lastValue = values.last();
     }
-    if ((log.size() != 0) && (log.end()->id != id)) {
+    if (log.id(log.size() - 1) != id) {
         ret.append({ lastTime, lastValue });
     }
     return ret;
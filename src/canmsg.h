@@ -5,12 +5,15 @@
 #include <QByteArray>
 #include <QString>
 #include <QList>
+#include <QHash>
 #include <QVector>
 #include <QDebug>
 #include <QColor>
 #include <QPair>
 
 constexpr uint16_t maxNormalCanId = 0x7FF;
+// Plots not tied to one message, such as the bus load
+constexpr uint32_t noCanId = UINT32_MAX;
 constexpr uint8_t normalCanNibble = 3;
 constexpr uint8_t extCanNibble = 8;
 constexpr uint8_t CAN_MAX_DLC = 8;
@@ -29,16 +32,21 @@ constexpr uint8_t GetNbit(uint8_t input, uint8_t n)
 
 using CAN_DIR = enum { CAN_DIR_RX = 0, CAN_DIR_TX };
 
+class FrameStore;
+
+/* (time, value) points of a decoded signal */
+using SignalGraph = QVector<QPair<double, double>>;
+
 struct CanLogMsg
 {
     CanLogMsg() : data({}){};
 
     bool setDir(const QString &str)
     {
-        if (str.compare("Rx")) {
+        if (str.compare("Rx") == 0) {
             dir = CAN_DIR_RX;
             return true;
-        } else if (str.compare("Tx")) {
+        } else if (str.compare("Tx") == 0) {
             dir = CAN_DIR_TX;
             return true;
         } else {
@@ -57,6 +65,39 @@ struct CanLogMsg
 
 struct CanSignal
 {
+    /* How to pull the raw value of a signal out of a payload, compiled from
+     * startBit, len, isBigEndian and isSigned */
+    struct Plan
+    {
+        enum Kind : uint8_t { Invalid, Generic, Byte, Word, DWord };
+
+        bool matches(const CanSignal &signal) const
+        {
+            return (startBit == signal.startBit) && (len == signal.len)
+                    && (isBigEndian == signal.isBigEndian)
+                    && (isSigned == signal.isSigned);
+        }
+
+        Kind kind{ Invalid };
+        uint8_t startBit{ 0 };
+        uint8_t len{ 0 };
+        bool isBigEndian{ false };
+        bool isSigned{ false };
+        uint8_t byteOfs{ 0 };
+        uint16_t endBit{ 0 };
+        // Widest raw value, more than len for unaligned big endian signals
+        uint8_t rawBits{ 0 };
+        /* Big endian: the payload word masked with fieldMask and byte
+         * swapped is shifted right by swapShift, leaving the last byte of
+         * the signal lowest. The lowBits below the first byte are kept, the
+         * first byte is moved down by firstShift - lowBits. */
+        uint8_t swapShift{ 0 };
+        uint8_t lowBits{ 0 };
+        uint8_t firstShift{ 0 };
+        uint64_t mask{ 0 };
+        uint64_t fieldMask{ 0 };
+    };
+
     CanSignal() = default;
     CanSignal(uint8_t startBit, uint8_t len, bool isBigEndian, bool isSigned,
               double scale, double offset)
@@ -67,6 +108,7 @@ struct CanSignal
           scale(scale),
           offset(offset)
     {
+        compile();
     }
     uint8_t startBit;
     uint8_t len;
@@ -80,6 +122,10 @@ struct CanSignal
     QString unit;
     QString receiver;
     QVector<QPair<double, QString>> values{};
+    Plan plan{};
+
+    static Plan compilePlan(const CanSignal &signal);
+    void compile() { plan = compilePlan(*this); }
 
     auto &getValuePairs() const { return values; }
 
@@ -88,9 +134,12 @@ struct CanSignal
         values.append(value);
     }
 
+    /* Raw value of a signal, before scale and offset */
+    static double parseRaw(const Plan &plan, const CanData &input,
+                           uint8_t dlc);
     static double parseSignal(const CanSignal &signal, const CanData &input,
                               uint8_t dlc);
-    QString display(double value)
+    QString display(double value) const
     {
         for (auto i : values) {
             if (i.first == value) {
@@ -100,15 +149,21 @@ struct CanSignal
         return QString("%1").arg(value);
     }
 
-    static QVector<QPair<double, double>>
-    getSignalGraph(const CanSignal &signal, uint32_t id,
-                   const QVector<CanLogMsg> &log);
+    static SignalGraph getSignalGraph(const CanSignal &signal, uint32_t id,
+                                      const FrameStore &log);
 };
 
 struct CanMessage
 {
     CanMessage() : color(0, 0, 0, 0) { }
-    void addCanSignal(const CanSignal &signal) { canSignals.append(signal); }
+    void addCanSignal(const CanSignal &signal)
+    {
+        if (!signalIndex.contains(signal.name)) {
+            signalIndex.insert(signal.name, canSignals.size());
+        }
+        canSignals.append(signal);
+        canSignals.last().compile();
+    }
     auto signalCount() const { return canSignals.size(); }
 
     static QString formatId(uint32_t id)
@@ -121,12 +176,11 @@ struct CanMessage
 
     CanSignal *findSignal(const QString &name)
     {
-        for (auto &canSignal : canSignals) {
-            if (canSignal.name == name) {
-                return &canSignal;
-            }
+        auto it = signalIndex.constFind(name);
+        if (it == signalIndex.cend()) {
+            return nullptr;
         }
-        return nullptr;
+        return &canSignals[it.value()];
     }
 
     QString formatId() { return formatId(id); }
@@ -137,34 +191,41 @@ struct CanMessage
     QString sender;
     QVector<CanSignal> canSignals;
     QColor color;
+
+private:
+    // Signal name to position in canSignals
+    QHash<QString, qsizetype> signalIndex{};
 };
 
 class CanDb
 {
 public:
-    CanDb() : db({}){};
-    void addMessage(const CanMessage &msg) { db.append(msg); }
+    CanDb() : db({}), normalIndex(maxNormalCanId + 1, noMessage){};
+    void addMessage(const CanMessage &msg)
+    {
+        // The first definition of an id wins, as with a linear search
+        if (indexOf(msg.id) == noMessage) {
+            if (msg.id <= maxNormalCanId) {
+                normalIndex[msg.id] = static_cast<int32_t>(db.size());
+            } else {
+                extIndex.insert(msg.id, static_cast<int32_t>(db.size()));
+            }
+        }
+        db.append(msg);
+    }
     auto messageCount() const { return db.count(); }
     auto &at(qsizetype i) const { return db.at(i); }
 
     const CanMessage *findMessage(uint32_t id) const
     {
-        for (const auto &i : db) {
-            if (i.id == id) {
-                return &i;
-            }
-        }
-        return nullptr;
+        auto i = indexOf(id);
+        return (i == noMessage) ? nullptr : &db.at(i);
     }
 
     CanMessage *findMessage(uint32_t id)
     {
-        for (auto &i : db) {
-            if (i.id == id) {
-                return &i;
-            }
-        }
-        return nullptr;
+        auto i = indexOf(id);
+        return (i == noMessage) ? nullptr : &db[i];
     }
 
     void setColor(uint32_t id, const QColor &color)
@@ -177,5 +238,19 @@ public:
     }
 
 private:
+    static constexpr int32_t noMessage = -1;
+
+    /* Standard ids are looked up in a direct table, extended ones in a
+     * hash. Both hold positions in db. */
+    int32_t indexOf(uint32_t id) const
+    {
+        if (id <= maxNormalCanId) {
+            return normalIndex.at(id);
+        }
+        return extIndex.value(id, noMessage);
+    }
+
     QVector<CanMessage> db;
+    QVector<int32_t> normalIndex;
+    QHash<uint32_t, int32_t> extIndex{};
 };
@@ -0,0 +1,33 @@
+#include "cpufeatures.h"
+
+static CpuFeatures detect()
+{
+    CpuFeatures features{};
+#ifdef CPU_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    auto maxLeaf = info[0];
+    __cpuid(info, 1);
+    features.sse42 = (info[2] & (1 << 20)) != 0;
+    // AVX state must also be enabled by the OS
+    auto osAvx = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0)
+            && ((_xgetbv(0) & 6) == 6);
+    if ((maxLeaf >= 7) && osAvx) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    features.sse42 = __builtin_cpu_supports("sse4.2") != 0;
+    features.avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+    return features;
+}
+
+const CpuFeatures &CpuFeatures::get()
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPU_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CPU_TARGET(arch)
+#else
+#define CPU_TARGET(arch) __attribute__((target(arch)))
+#endif
+#endif
+
+/* Vector extensions of the running CPU, for kernels compiled with
+ * CPU_TARGET and picked at runtime */
+struct CpuFeatures
+{
+    bool sse42{ false };
+    bool avx2{ false };
+
+    static const CpuFeatures &get();
+};
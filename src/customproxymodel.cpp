@@ -1,5 +1,279 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <utility>
 #include <QFont>
+#include <QSet>
+#include <QStringList>
+#include <QtConcurrent>
+#include <QtEndian>
 #include "customproxymodel.h"
+#include "canlogmodel.h"
+#include "radixsort.h"
+
+namespace {
+
+constexpr int idColumn = 3;
+constexpr int nameColumn = 5;
+
+/* Everything a filter run reads, copied so the GUI can go on loading */
+struct FilterJob
+{
+    FrameStore frames;
+    CanDb db;
+    QHash<uint8_t, QRegularExpression> regex;
+    QString expression;
+    int sortColumn;
+    Qt::SortOrder sortOrder;
+    CustomProxyModel::Generation latest;
+    quint64 generation;
+
+    bool stale() const { return *latest != generation; }
+};
+
+bool isIdColumn(int column)
+{
+    return (column == idColumn) || (column == nameColumn);
+}
+
+bool matchColumns(const QList<QPair<int, QRegularExpression>> &columns,
+                  const CanLogMsg &item, const CanMessage *msg)
+{
+    for (const auto &column : columns) {
+        if (!CanLogModel::formatFrame(item, msg, column.first)
+                     .contains(column.second)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t timeKey(double time)
+{
+    // Orders like the doubles: negatives have all bits flipped, the others
+    // only the sign bit
+    uint64_t bits = 0;
+    std::memcpy(&bits, &time, sizeof(bits));
+    return ((bits >> 63) != 0) ? ~bits : (bits | (uint64_t(1) << 63));
+}
+
+uint64_t sortKey(const FrameBlock &block, qsizetype i, int column,
+                 const QHash<uint32_t, uint64_t> &nameRank)
+{
+    switch (column) {
+    case 0:
+        return block.number.at(i);
+    case 1:
+        return timeKey(block.time.at(i));
+    case 2:
+        return block.channel.at(i);
+    case idColumn:
+        return block.id.at(i);
+    case 4:
+        return block.dlc.at(i);
+    case nameColumn:
+        return nameRank.value(block.id.at(i));
+    case 6:
+        return qFromBigEndian<quint64>(block.data.at(i).data());
+    default:
+        return 0;
+    }
+}
+
+/* Sorts the rows by integer keys read straight from the frame columns,
+ * message names are ranked once per distinct ID */
+void sortRows(const FilterJob &job, CustomProxyModel::Rows &rows)
+{
+    const auto &frames = job.frames;
+    QHash<uint32_t, uint64_t> nameRank{};
+    if (job.sortColumn == nameColumn) {
+        QHash<uint32_t, QString> names{};
+        QStringList sorted{};
+        for (auto key : frames.frameKeys()) {
+            auto id = FrameStore::keyId(key);
+            if (names.contains(id)) {
+                continue;
+            }
+            const auto *msg = job.db.findMessage(id);
+            auto name = (msg == nullptr) ? QString() : msg->name;
+            names.insert(id, name);
+            sorted.append(name);
+        }
+        sorted.sort();
+        sorted.removeDuplicates();
+        for (auto it = names.cbegin(); it != names.cend(); it++) {
+            auto rank = std::lower_bound(sorted.cbegin(), sorted.cend(),
+                                         it.value())
+                    - sorted.cbegin();
+            nameRank.insert(it.key(), static_cast<uint64_t>(rank));
+        }
+    }
+
+    auto count = static_cast<qsizetype>(rows.size());
+    auto descending = (job.sortOrder == Qt::DescendingOrder);
+    std::vector<uint64_t> keys(count);
+    QVector<qsizetype> chunks((count + FrameStore::blockSize - 1)
+                              / FrameStore::blockSize);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    QtConcurrent::blockingMap(chunks, [&](qsizetype c) {
+        if (job.stale()) {
+            return;
+        }
+        auto first = c * FrameStore::blockSize;
+        auto last = std::min(first + FrameStore::blockSize, count);
+        // Rows are ascending here, the block changes rarely
+        qsizetype blockIndex = -1;
+        FrameStore::BlockPtr block{};
+        for (auto i = first; i < last; i++) {
+            auto row = static_cast<qsizetype>(rows[i]);
+            if (FrameStore::blockOf(row) != blockIndex) {
+                blockIndex = FrameStore::blockOf(row);
+                block = frames.block(blockIndex);
+            }
+            auto key = sortKey(*block, row - FrameStore::blockStart(blockIndex),
+                               job.sortColumn, nameRank);
+            // Equal keys keep the source order either way
+            keys[i] = descending ? ~key : key;
+        }
+    });
+    RadixSort::sort(keys, rows);
+}
+
+CustomProxyModel::Mapping runFilter(const FilterJob &job)
+{
+    const auto &frames = job.frames;
+    CustomProxyModel::Mapping mapping{};
+    mapping.sourceRows = static_cast<std::size_t>(frames.size());
+    RowBitmap matching{};
+    if (!job.expression.isEmpty()) {
+        try {
+            matching = FilterExpr::compile(job.expression, job.db)
+                               .evaluate(frames);
+        } catch (const std::runtime_error &) {
+            // A database without the signal filters every row out
+            return mapping;
+        }
+    }
+
+    QList<QPair<int, QRegularExpression>> idColumns{};
+    QList<QPair<int, QRegularExpression>> rowColumns{};
+    for (auto it = job.regex.cbegin(); it != job.regex.cend(); it++) {
+        (isIdColumn(it.key()) ? idColumns : rowColumns)
+                .append({ it.key(), it.value() });
+    }
+    /* The ID and message name columns only depend on the CAN ID, their
+     * filters are evaluated once per distinct ID instead of once per row */
+    QSet<uint32_t> acceptedIds{};
+    if (!idColumns.isEmpty()) {
+        for (auto key : frames.frameKeys()) {
+            auto id = FrameStore::keyId(key);
+            if (acceptedIds.contains(id)) {
+                continue;
+            }
+            // Any frame of the id formats the same, use the first one
+            auto item = frames.at(frames.rows(FrameStore::keyChannel(key), id)
+                                          .first());
+            if (matchColumns(idColumns, item, job.db.findMessage(id))) {
+                acceptedIds.insert(id);
+            }
+        }
+    }
+
+    std::vector<CustomProxyModel::Rows> parts(frames.blockCount());
+    QVector<qsizetype> blocks(frames.blockCount());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    QtConcurrent::blockingMap(blocks, [&](qsizetype b) {
+        if (job.stale()) {
+            return;
+        }
+        auto block = frames.block(b);
+        auto first = FrameStore::blockStart(b);
+        auto &part = parts[b];
+        for (qsizetype i = 0; i < block->size(); i++) {
+            auto row = first + i;
+            if (!matching.isEmpty() && !testRow(matching, row)) {
+                continue;
+            }
+            if (!idColumns.isEmpty() && !acceptedIds.contains(block->id.at(i))) {
+                continue;
+            }
+            if (!rowColumns.isEmpty()) {
+                auto item = block->at(i);
+                if (!matchColumns(rowColumns, item,
+                                  job.db.findMessage(item.id))) {
+                    continue;
+                }
+            }
+            part.push_back(static_cast<uint32_t>(row));
+        }
+    });
+
+    // A newer run replaces this one, its result is never shown
+    if (job.stale()) {
+        return mapping;
+    }
+    std::size_t total = 0;
+    for (const auto &part : parts) {
+        total += part.size();
+    }
+    auto &rows = mapping.rows;
+    rows.reserve(total);
+    for (const auto &part : parts) {
+        rows.insert(rows.end(), part.cbegin(), part.cend());
+    }
+    if (job.sortColumn >= 0) {
+        sortRows(job, rows);
+        mapping.proxyRows.assign(frames.size(), -1);
+        for (std::size_t i = 0; i < rows.size(); i++) {
+            mapping.proxyRows[rows[i]] = static_cast<int32_t>(i);
+        }
+    }
+    return mapping;
+}
+
+} // namespace
+
+CustomProxyModel::CustomProxyModel(QObject *parent)
+    : QAbstractProxyModel(parent)
+{
+    connect(&filterWatcher, &QFutureWatcher<Mapping>::finished, this,
+            &CustomProxyModel::onFilterFinished);
+}
+
+void CustomProxyModel::setSourceModel(QAbstractItemModel *model)
+{
+    beginResetModel();
+    for (const auto &connection : std::as_const(sourceConnections)) {
+        disconnect(connection);
+    }
+    sourceConnections.clear();
+    QAbstractProxyModel::setSourceModel(model);
+    mapped = false;
+    mapping = {};
+    if (model != nullptr) {
+        sourceConnections.append(
+                connect(model, &QAbstractItemModel::modelAboutToBeReset, this,
+                        [this]() { beginResetModel(); }));
+        sourceConnections.append(
+                connect(model, &QAbstractItemModel::modelReset, this, [this]() {
+                    /* The rows of another trace mean nothing, it is shown
+                     * whole until its own filter run is done */
+                    if (mapping.sourceRows
+                        != static_cast<std::size_t>(
+                                sourceModel()->rowCount())) {
+                        mapped = false;
+                        mapping = {};
+                    }
+                    endResetModel();
+                    refilter();
+                }));
+        sourceConnections.append(
+                connect(model, &QAbstractItemModel::dataChanged, this,
+                        &CustomProxyModel::onSourceDataChanged));
+    }
+    endResetModel();
+    refilter();
+}
 
 void CustomProxyModel::setFilter(uint8_t column, const QString &expression)
 {
@@ -9,29 +283,223 @@ void CustomProxyModel::setFilter(uint8_t column, const QString &expression)
         regex[column] = QRegularExpression(
                 expression, QRegularExpression::CaseInsensitiveOption);
     }
-    invalidateFilter();
+    emit headerDataChanged(Qt::Horizontal, column, column);
+    refilter();
+}
+
+void CustomProxyModel::setFilterExpression(const QString &text)
+{
+    const auto *logModel = qobject_cast<const CanLogModel *>(sourceModel());
+    if (logModel != nullptr) {
+        // Only checks the text, the filter run compiles its own copy
+        FilterExpr::compile(text, logModel->database());
+    }
+    expressionText = text.trimmed();
+    refilter();
+}
+
+void CustomProxyModel::sort(int column, Qt::SortOrder order)
+{
+    if ((column == sortColumn) && (order == sortOrder)) {
+        return;
+    }
+    sortColumn = column;
+    sortOrder = order;
+    refilter();
+}
+
+void CustomProxyModel::refilter()
+{
+    auto current = ++*generation;
+    const auto *logModel = qobject_cast<const CanLogModel *>(sourceModel());
+    if ((logModel == nullptr)
+        || (regex.isEmpty() && expressionText.isEmpty() && (sortColumn < 0))) {
+        // Drops a pending run, its result would come back mapped
+        filterWatcher.setFuture(QFuture<Mapping>());
+        if (mapped) {
+            setMapping({}, false);
+        }
+        return;
+    }
+    FilterJob job{ logModel->frames(), logModel->database(), regex,
+                   expressionText, sortColumn, sortOrder, generation,
+                   current };
+    filterWatcher.setFuture(QtConcurrent::run(runFilter, std::move(job)));
+}
+
+void CustomProxyModel::onFilterFinished()
+{
+    if (filterWatcher.isCanceled()) {
+        return;
+    }
+    setMapping(filterWatcher.future().takeResult(), true);
 }
 
-bool CustomProxyModel::filterAcceptsRow(int sourceRow,
-                                        const QModelIndex &parent) const
+void CustomProxyModel::setMapping(Mapping next, bool nextMapped)
 {
-    auto match = true;
+    // Selection and current row follow their frames to the new rows
+    emit layoutAboutToBeChanged();
+    const auto persistent = persistentIndexList();
+    QModelIndexList sources{};
+    sources.reserve(persistent.size());
+    for (const auto &index : persistent) {
+        sources.append(mapToSource(index));
+    }
+    mapping = std::move(next);
+    mapped = nextMapped;
+    QModelIndexList updated{};
+    updated.reserve(sources.size());
+    for (const auto &source : std::as_const(sources)) {
+        updated.append(mapFromSource(source));
+    }
+    changePersistentIndexList(persistent, updated);
+    emit layoutChanged();
+}
+
+int CustomProxyModel::proxyRow(int row) const
+{
+    if (!mapped) {
+        return row;
+    }
+    if (!mapping.proxyRows.empty()) {
+        return ((row >= 0)
+                && (static_cast<std::size_t>(row) < mapping.proxyRows.size()))
+                ? mapping.proxyRows[row]
+                : -1;
+    }
+    const auto &rows = mapping.rows;
+    auto it = std::lower_bound(rows.cbegin(), rows.cend(),
+                               static_cast<uint32_t>(row));
+    if ((it == rows.cend()) || (*it != static_cast<uint32_t>(row))) {
+        return -1;
+    }
+    return static_cast<int>(it - rows.cbegin());
+}
+
+QModelIndex CustomProxyModel::index(int row, int column,
+                                    const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent)) {
+        return {};
+    }
     if (parent.isValid()) {
-        return true;
+        // Signal rows carry the proxy row of their frame, plus one
+        return createIndex(row, column, static_cast<quintptr>(parent.row()) + 1);
     }
-    for (auto it = regex.begin(); it != regex.end(); it++) {
-        auto index = sourceModel()->index(sourceRow, it.key());
-        auto contain =
-                sourceModel()->data(index).toString().contains(it.value());
-        if (!contain)
-            return false;
+    return createIndex(row, column);
+}
+
+QModelIndex CustomProxyModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid() || (child.internalId() == 0)) {
+        return {};
     }
-    return true;
+    return createIndex(static_cast<int>(child.internalId() - 1), 0);
+}
+
+int CustomProxyModel::rowCount(const QModelIndex &parent) const
+{
+    if (sourceModel() == nullptr) {
+        return 0;
+    }
+    if (parent.isValid()) {
+        return sourceModel()->rowCount(mapToSource(parent));
+    }
+    return mapped ? static_cast<int>(mapping.rows.size())
+                  : sourceModel()->rowCount();
+}
+
+int CustomProxyModel::columnCount(const QModelIndex &parent) const
+{
+    if (sourceModel() == nullptr) {
+        return 0;
+    }
+    return sourceModel()->columnCount(mapToSource(parent));
+}
+
+QModelIndex CustomProxyModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if ((sourceModel() == nullptr) || !proxyIndex.isValid()) {
+        return {};
+    }
+    if (proxyIndex.internalId() == 0) {
+        return sourceModel()->index(sourceRow(proxyIndex.row()),
+                                    proxyIndex.column(), {});
+    }
+    auto sourceParent = sourceModel()->index(
+            sourceRow(static_cast<int>(proxyIndex.internalId() - 1)), 0, {});
+    return sourceModel()->index(proxyIndex.row(), proxyIndex.column(),
+                                sourceParent);
+}
+
+QModelIndex CustomProxyModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if ((sourceModel() == nullptr) || !sourceIndex.isValid()) {
+        return {};
+    }
+    auto sourceParent = sourceIndex.parent();
+    if (!sourceParent.isValid()) {
+        auto row = proxyRow(sourceIndex.row());
+        return (row < 0) ? QModelIndex() : createIndex(row, sourceIndex.column());
+    }
+    auto parentRow = proxyRow(sourceParent.row());
+    if (parentRow < 0) {
+        return {};
+    }
+    return createIndex(sourceIndex.row(), sourceIndex.column(),
+                       static_cast<quintptr>(parentRow) + 1);
+}
+
+void CustomProxyModel::onSourceDataChanged(const QModelIndex &topLeft,
+                                           const QModelIndex &bottomRight,
+                                           const QList<int> &roles)
+{
+    if (topLeft.parent().isValid()) {
+        auto first = mapFromSource(topLeft);
+        auto last = mapFromSource(bottomRight);
+        if (first.isValid() && last.isValid()) {
+            emit dataChanged(first, last, roles);
+        }
+        return;
+    }
+    // Proxy rows from the first to the last accepted row of the range
+    auto first = topLeft.row();
+    auto last = bottomRight.row();
+    const auto &rows = mapping.rows;
+    if (mapped && !mapping.proxyRows.empty() && (first != last)) {
+        // Sorted rows of the range are scattered, repaint them all
+        if (rows.empty()) {
+            return;
+        }
+        first = 0;
+        last = static_cast<int>(rows.size()) - 1;
+    } else if (mapped && !mapping.proxyRows.empty()) {
+        first = proxyRow(first);
+        if (first < 0) {
+            return;
+        }
+        last = first;
+    } else if (mapped) {
+        auto begin = std::lower_bound(rows.cbegin(), rows.cend(),
+                                      static_cast<uint32_t>(first));
+        auto end = std::upper_bound(begin, rows.cend(),
+                                    static_cast<uint32_t>(last));
+        if (begin == end) {
+            return;
+        }
+        first = static_cast<int>(begin - rows.cbegin());
+        last = static_cast<int>(end - rows.cbegin()) - 1;
+    }
+    emit dataChanged(createIndex(first, topLeft.column()),
+                     createIndex(last, bottomRight.column()), roles);
 }
 
 QVariant CustomProxyModel::headerData(int section, Qt::Orientation orientation,
                                       int role) const
 {
+    if (sourceModel() == nullptr) {
+        return {};
+    }
     if ((role != Qt::FontRole) || (orientation != Qt::Horizontal)
         || (!regex.contains(section)))
         return sourceModel()->headerData(section, orientation, role);
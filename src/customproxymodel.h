@@ -1,14 +1,37 @@
 #pragma once
-#include <QSortFilterProxyModel>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <QAbstractProxyModel>
+#include <QFutureWatcher>
 #include <QRegularExpression>
 #include <QHash>
+#include "filterexpr.h"
 
-class CustomProxyModel : public QSortFilterProxyModel
+/* Flat proxy over CanLogModel keeping the accepted source rows in one
+ * vector, in display order. The vector is computed on the thread pool from
+ * copies of the frames and the database, filtered and then sorted with
+ * keys taken from the frame columns. The previous vector stays in use until
+ * then, and the new one is swapped in as a layout change that keeps the
+ * selection; the signal rows under every frame are passed through
+ * unfiltered. */
+class CustomProxyModel : public QAbstractProxyModel
 {
 public:
-    CustomProxyModel(QObject *parent = nullptr) : QSortFilterProxyModel(parent)
+    using Rows = std::vector<uint32_t>;
+    struct Mapping
     {
-    }
+        Rows rows;
+        // Proxy row of every source row, -1 when filtered out. Only kept
+        // when sorted, rows are ascending otherwise.
+        std::vector<int32_t> proxyRows;
+        // Rows of the source it was made for
+        std::size_t sourceRows{ 0 };
+    };
+    // Bumped on every refilter, a run of an older one stops early
+    using Generation = std::shared_ptr<std::atomic<quint64>>;
+
+    CustomProxyModel(QObject *parent = nullptr);
 
     QString getFilterText(uint8_t column) const
     {
@@ -19,12 +42,47 @@ public:
         return re.pattern();
     }
 
+    void setSourceModel(QAbstractItemModel *model) override;
     void setFilter(uint8_t column, const QString &expression);
-    bool filterAcceptsRow(int sourceRow, const QModelIndex &) const override;
+    /* Compiles a FilterExpr against the database of the source CanLogModel,
+     * throws std::runtime_error when it does not compile */
+    void setFilterExpression(const QString &text);
+    QString filterExpression() const { return expressionText; }
+    /* Sorts by a frame column, -1 restores the source order */
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    QModelIndex index(int row, int column,
+                      const QModelIndex &parent = {}) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
 
     QVariant headerData(int section, Qt::Orientation orientation,
                         int role = Qt::DisplayRole) const override;
 
 private:
+    int sourceRow(int row) const
+    {
+        return mapped ? static_cast<int>(mapping.rows[row]) : row;
+    }
+    int proxyRow(int row) const;
+    void refilter();
+    void onFilterFinished();
+    void setMapping(Mapping next, bool nextMapped);
+    void onSourceDataChanged(const QModelIndex &topLeft,
+                             const QModelIndex &bottomRight,
+                             const QList<int> &roles);
+
     QHash<uint8_t, QRegularExpression> regex;
+    QString expressionText{};
+    int sortColumn{ -1 };
+    Qt::SortOrder sortOrder{ Qt::AscendingOrder };
+    /* Without any filter or sort the proxy maps rows one to one */
+    bool mapped{ false };
+    Mapping mapping{};
+    QFutureWatcher<Mapping> filterWatcher{};
+    Generation generation{ std::make_shared<std::atomic<quint64>>(0) };
+    QList<QMetaObject::Connection> sourceConnections{};
 };
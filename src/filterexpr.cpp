@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <QHash>
+#include <QtConcurrent>
+#include "filterexpr.h"
+
+constexpr int bitsPerWord = 64;
+
+struct FilterExpr::Node
+{
+    enum Kind { And, Or, Not, Field, Signal };
+    enum Column { Id, Chan, Dlc, Dir, Number, Time, Byte };
+    enum Op { Eq, Ne, Lt, Le, Gt, Ge, In };
+
+    Kind kind{ Field };
+    Column column{ Id };
+    uint8_t byte{ 0 };
+    Op op{ Eq };
+    double lo{ 0 };
+    double hi{ 0 };
+    // Signal of the given name in every message carrying it
+    QHash<uint32_t, CanSignal> signalById{};
+    std::shared_ptr<const Node> left{};
+    std::shared_ptr<const Node> right{};
+};
+
+namespace {
+
+using Node = FilterExpr::Node;
+using NodePtr = std::shared_ptr<const Node>;
+
+struct Token
+{
+    enum Type { End, Name, Number, Symbol };
+    Type type;
+    std::string text;
+    double value;
+    qsizetype pos;
+};
+
+[[noreturn]] void fail(const QString &message, qsizetype pos)
+{
+    throw std::runtime_error(
+            QString("%1 at %2").arg(message).arg(pos + 1).toStdString());
+}
+
+QVector<Token> tokenize(const std::string &text)
+{
+    static const char *const symbols[] = { "&&", "||", "==", "!=", "<=",
+                                           ">=", "..", "<",  ">",  "!",
+                                           "(",  ")" };
+    QVector<Token> tokens{};
+    qsizetype pos = 0;
+    auto size = static_cast<qsizetype>(text.size());
+    while (pos < size) {
+        auto c = text[pos];
+        if (std::isspace(static_cast<unsigned char>(c)) != 0) {
+            pos++;
+            continue;
+        }
+        auto start = pos;
+        if ((std::isalpha(static_cast<unsigned char>(c)) != 0) || (c == '_')) {
+            while ((pos < size)
+                   && ((std::isalnum(static_cast<unsigned char>(text[pos]))
+                        != 0)
+                       || (text[pos] == '_'))) {
+                pos++;
+            }
+            tokens.append({ Token::Name, text.substr(start, pos - start), 0,
+                            start });
+            continue;
+        }
+        auto negative = (c == '-') && (pos + 1 < size)
+                && (std::isdigit(static_cast<unsigned char>(text[pos + 1]))
+                    != 0);
+        if ((std::isdigit(static_cast<unsigned char>(c)) != 0) || negative) {
+            if (negative) {
+                pos++;
+            }
+            double value = 0;
+            if ((text.compare(pos, 2, "0x") == 0)
+                || (text.compare(pos, 2, "0X") == 0)) {
+                pos += 2;
+                auto digits = pos;
+                while ((pos < size)
+                       && (std::isxdigit(static_cast<unsigned char>(text[pos]))
+                           != 0)) {
+                    pos++;
+                }
+                if (pos == digits) {
+                    fail("Expected hex digits", pos);
+                }
+                if (pos - digits > 16) {
+                    fail("Number too large", start);
+                }
+                value = static_cast<double>(
+                        std::stoull(text.substr(digits, pos - digits), nullptr,
+                                    16));
+            } else {
+                while ((pos < size)
+                       && ((std::isdigit(static_cast<unsigned char>(text[pos]))
+                            != 0)
+                           // Stop before a range operator
+                           || ((text[pos] == '.')
+                               && (text.compare(pos, 2, "..") != 0)))) {
+                    pos++;
+                }
+                auto digits = start + (negative ? 1 : 0);
+                std::size_t used = 0;
+                try {
+                    value = std::stod(text.substr(digits, pos - digits), &used);
+                } catch (const std::logic_error &) {
+                }
+                if (used != static_cast<std::size_t>(pos - digits)) {
+                    fail("Invalid number", start);
+                }
+            }
+            tokens.append({ Token::Number, text.substr(start, pos - start),
+                            negative ? -value : value, start });
+            continue;
+        }
+        auto found = false;
+        for (const auto *symbol : symbols) {
+            auto len = static_cast<qsizetype>(std::char_traits<char>::length(
+                    symbol));
+            if (text.compare(pos, len, symbol) == 0) {
+                tokens.append({ Token::Symbol, symbol, 0, pos });
+                pos += len;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            fail(QString("Unexpected '%1'").arg(c), pos);
+        }
+    }
+    tokens.append({ Token::End, {}, 0, size });
+    return tokens;
+}
+
+class Parser
+{
+public:
+    Parser(const QVector<Token> &tokens, const CanDb &db)
+        : tokens(tokens), db(db)
+    {
+    }
+
+    NodePtr parse()
+    {
+        auto node = parseOr();
+        if (peek().type != Token::End) {
+            fail("Unexpected '" + QString::fromStdString(peek().text) + "'",
+                 peek().pos);
+        }
+        return node;
+    }
+
+private:
+    const Token &peek() const { return tokens.at(pos); }
+    const Token &next() { return tokens.at(pos++); }
+    bool accept(const char *symbol)
+    {
+        if ((peek().type == Token::Symbol) && (peek().text == symbol)) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    void expect(const char *symbol)
+    {
+        if (!accept(symbol)) {
+            fail(QString("Expected '%1'").arg(symbol), peek().pos);
+        }
+    }
+
+    static NodePtr combine(Node::Kind kind, NodePtr left, NodePtr right)
+    {
+        auto node = std::make_shared<Node>();
+        node->kind = kind;
+        node->left = std::move(left);
+        node->right = std::move(right);
+        return node;
+    }
+
+    NodePtr parseOr()
+    {
+        auto node = parseAnd();
+        while (accept("||")) {
+            node = combine(Node::Or, node, parseAnd());
+        }
+        return node;
+    }
+
+    NodePtr parseAnd()
+    {
+        auto node = parseUnary();
+        while (accept("&&")) {
+            node = combine(Node::And, node, parseUnary());
+        }
+        return node;
+    }
+
+    NodePtr parseUnary()
+    {
+        if (accept("!")) {
+            return combine(Node::Not, parseUnary(), nullptr);
+        }
+        if (accept("(")) {
+            auto node = parseOr();
+            expect(")");
+            return node;
+        }
+        return parseComparison();
+    }
+
+    double parseValue(const Node &node)
+    {
+        const auto &token = next();
+        if (token.type == Token::Number) {
+            return token.value;
+        }
+        if ((token.type == Token::Name) && (node.kind == Node::Field)
+            && (node.column == Node::Dir)) {
+            auto name = QString::fromStdString(token.text).toLower();
+            if (name == "rx") {
+                return CAN_DIR_RX;
+            }
+            if (name == "tx") {
+                return CAN_DIR_TX;
+            }
+        }
+        fail("Expected a value", token.pos);
+    }
+
+    void parseField(Node &node, const Token &token)
+    {
+        static const QHash<QString, Node::Column> columns{
+            { "id", Node::Id },         { "chan", Node::Chan },
+            { "channel", Node::Chan },  { "dlc", Node::Dlc },
+            { "dir", Node::Dir },       { "no", Node::Number },
+            { "number", Node::Number }, { "t", Node::Time },
+            { "time", Node::Time },
+        };
+        auto name = QString::fromStdString(token.text);
+        auto lower = name.toLower();
+        if (columns.contains(lower)) {
+            node.column = columns.value(lower);
+            return;
+        }
+        if ((lower.size() == 2) && (lower.at(0) == 'b')
+            && (lower.at(1) >= '0') && (lower.at(1) < '0' + CAN_MAX_DLC)) {
+            node.column = Node::Byte;
+            node.byte = static_cast<uint8_t>(lower.at(1).unicode() - '0');
+            return;
+        }
+        node.kind = Node::Signal;
+        for (qsizetype i = 0; i < db.messageCount(); i++) {
+            const auto &msg = db.at(i);
+            for (const auto &signal : msg.canSignals) {
+                if ((signal.name == name)
+                    && !node.signalById.contains(msg.id)) {
+                    node.signalById.insert(msg.id, signal);
+                }
+            }
+        }
+        if (node.signalById.isEmpty()) {
+            fail(QString("Unknown field or signal '%1'").arg(name), token.pos);
+        }
+    }
+
+    NodePtr parseComparison()
+    {
+        static const QHash<QString, Node::Op> ops{
+            { "==", Node::Eq }, { "!=", Node::Ne }, { "<", Node::Lt },
+            { "<=", Node::Le }, { ">", Node::Gt },  { ">=", Node::Ge },
+        };
+        const auto &token = next();
+        if (token.type != Token::Name) {
+            fail("Expected a field or signal name", token.pos);
+        }
+        auto node = std::make_shared<Node>();
+        parseField(*node, token);
+
+        const auto &op = next();
+        if ((op.type == Token::Name) && (op.text == "in")) {
+            node->op = Node::In;
+            node->lo = parseValue(*node);
+            expect("..");
+            node->hi = parseValue(*node);
+            return node;
+        }
+        auto symbol = QString::fromStdString(op.text);
+        if ((op.type != Token::Symbol) || !ops.contains(symbol)) {
+            fail("Expected a comparison", op.pos);
+        }
+        node->op = ops.value(symbol);
+        node->lo = parseValue(*node);
+        return node;
+    }
+
+    const QVector<Token> &tokens;
+    const CanDb &db;
+    qsizetype pos{ 0 };
+};
+
+template<typename Pred>
+void setBits(quint64 *words, qsizetype count, Pred pred)
+{
+    for (qsizetype w = 0; w * bitsPerWord < count; w++) {
+        auto first = w * bitsPerWord;
+        auto last = std::min<qsizetype>(first + bitsPerWord, count);
+        quint64 bits = 0;
+        for (auto i = first; i < last; i++) {
+            bits |= quint64(pred(i) ? 1 : 0) << (i - first);
+        }
+        words[w] = bits;
+    }
+}
+
+bool compare(Node::Op op, double value, double lo, double hi)
+{
+    switch (op) {
+    case Node::Eq:
+        return value == lo;
+    case Node::Ne:
+        return value != lo;
+    case Node::Lt:
+        return value < lo;
+    case Node::Le:
+        return value <= lo;
+    case Node::Gt:
+        return value > lo;
+    case Node::Ge:
+        return value >= lo;
+    case Node::In:
+        return (value >= lo) && (value <= hi);
+    }
+    return false;
+}
+
+/* One tight loop per column and operator */
+template<typename Get>
+void evalColumn(const Node &node, qsizetype count, quint64 *words, Get get)
+{
+    auto lo = node.lo;
+    auto hi = node.hi;
+    switch (node.op) {
+    case Node::Eq:
+        setBits(words, count, [&](qsizetype i) { return get(i) == lo; });
+        break;
+    case Node::Ne:
+        setBits(words, count, [&](qsizetype i) { return get(i) != lo; });
+        break;
+    case Node::Lt:
+        setBits(words, count, [&](qsizetype i) { return get(i) < lo; });
+        break;
+    case Node::Le:
+        setBits(words, count, [&](qsizetype i) { return get(i) <= lo; });
+        break;
+    case Node::Gt:
+        setBits(words, count, [&](qsizetype i) { return get(i) > lo; });
+        break;
+    case Node::Ge:
+        setBits(words, count, [&](qsizetype i) { return get(i) >= lo; });
+        break;
+    case Node::In:
+        setBits(words, count, [&](qsizetype i) {
+            auto value = get(i);
+            return (value >= lo) && (value <= hi);
+        });
+        break;
+    }
+}
+
+void evalNode(const Node &node, const FrameBlock &block, quint64 *words)
+{
+    auto count = block.size();
+    auto wordCount = (count + bitsPerWord - 1) / bitsPerWord;
+    switch (node.kind) {
+    case Node::And:
+    case Node::Or: {
+        evalNode(*node.left, block, words);
+        QVector<quint64> other(wordCount);
+        evalNode(*node.right, block, other.data());
+        for (qsizetype w = 0; w < wordCount; w++) {
+            words[w] = (node.kind == Node::And) ? (words[w] & other.at(w))
+                                                : (words[w] | other.at(w));
+        }
+        return;
+    }
+    case Node::Not:
+        evalNode(*node.left, block, words);
+        for (qsizetype w = 0; w < wordCount; w++) {
+            words[w] = ~words[w];
+        }
+        if ((count % bitsPerWord) != 0) {
+            words[wordCount - 1] &= (quint64(1) << (count % bitsPerWord)) - 1;
+        }
+        return;
+    case Node::Signal: {
+        const auto *ids = block.id.constData();
+        const CanSignal *signal = nullptr;
+        uint32_t lastId = 0;
+        auto known = false;
+        setBits(words, count, [&](qsizetype i) {
+            // Frames of one id often come in runs, skip the lookup then
+            if (!known || (ids[i] != lastId)) {
+                auto it = node.signalById.constFind(ids[i]);
+                signal = (it == node.signalById.cend()) ? nullptr : &it.value();
+                lastId = ids[i];
+                known = true;
+            }
+            if (signal == nullptr) {
+                return false;
+            }
+            return compare(node.op,
+                           CanSignal::parseSignal(*signal, block.data.at(i),
+                                                  block.dlc.at(i)),
+                           node.lo, node.hi);
+        });
+        return;
+    }
+    case Node::Field:
+        break;
+    }
+
+    switch (node.column) {
+    case Node::Id: {
+        const auto *col = block.id.constData();
+        evalColumn(node, count, words, [col](qsizetype i) { return col[i]; });
+        break;
+    }
+    case Node::Chan: {
+        const auto *col = block.channel.constData();
+        evalColumn(node, count, words, [col](qsizetype i) { return col[i]; });
+        break;
+    }
+    case Node::Dlc: {
+        const auto *col = block.dlc.constData();
+        evalColumn(node, count, words, [col](qsizetype i) { return col[i]; });
+        break;
+    }
+    case Node::Dir: {
+        const auto *col = block.dir.constData();
+        evalColumn(node, count, words, [col](qsizetype i) { return col[i]; });
+        break;
+    }
+    case Node::Number: {
+        const auto *col = block.number.constData();
+        evalColumn(node, count, words, [col](qsizetype i) { return col[i]; });
+        break;
+    }
+    case Node::Time: {
+        const auto *col = block.time.constData();
+        evalColumn(node, count, words, [col](qsizetype i) { return col[i]; });
+        break;
+    }
+    case Node::Byte: {
+        const auto *col = block.data.constData();
+        auto byte = node.byte;
+        evalColumn(node, count, words,
+                   [col, byte](qsizetype i) { return col[i][byte]; });
+        break;
+    }
+    }
+}
+
+} // namespace
+
+FilterExpr FilterExpr::compile(const QString &text, const CanDb &db)
+{
+    FilterExpr expr{};
+    if (text.trimmed().isEmpty()) {
+        return expr;
+    }
+    auto tokens = tokenize(text.toStdString());
+    expr.root = Parser(tokens, db).parse();
+    return expr;
+}
+
+RowBitmap FilterExpr::evaluate(const FrameStore &frames) const
+{
+    RowBitmap bitmap((frames.size() + bitsPerWord - 1) / bitsPerWord);
+    if (root == nullptr) {
+        bitmap.fill(~quint64(0));
+        return bitmap;
+    }
+    /* Blocks hold a multiple of 64 frames, each one fills its own words */
+    static_assert((FrameStore::blockSize % bitsPerWord) == 0);
+    QVector<qsizetype> blocks(frames.blockCount());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    auto *words = bitmap.data();
+    const auto &node = *root;
+    QtConcurrent::blockingMap(blocks, [&](qsizetype b) {
+        auto block = frames.block(b);
+        evalNode(node, *block,
+                 words + (FrameStore::blockStart(b) / bitsPerWord));
+    });
+    return bitmap;
+}
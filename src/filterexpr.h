@@ -0,0 +1,39 @@
+#pragma once
+#include <memory>
+#include <QString>
+#include <QVector>
+#include "canmsg.h"
+#include "framestore.h"
+
+/* One bit per row of a FrameStore */
+using RowBitmap = QVector<quint64>;
+
+inline bool testRow(const RowBitmap &bitmap, qsizetype row)
+{
+    return ((bitmap.at(row >> 6) >> (row & 63)) & 1) != 0;
+}
+
+/* Filter expressions over frame fields and decoded signals, e.g.
+ *   id in 0x100..0x1FF && chan == 1 && EngineSpeed > 3000 && t > 12.5
+ *
+ * Fields: id, chan, dlc, dir (rx/tx), no, t, b0..b7 (payload bytes). Any
+ * other name is a DBC signal, compared on the frames of the messages that
+ * carry it. Comparisons are ==, !=, <, <=, >, >= and "in lo..hi"; they are
+ * combined with &&, ||, ! and parentheses. */
+class FilterExpr
+{
+public:
+    FilterExpr() = default;
+
+    /* Throws std::runtime_error on a syntax error or an unknown name */
+    static FilterExpr compile(const QString &text, const CanDb &db);
+
+    bool isEmpty() const { return root == nullptr; }
+    /* Evaluates every block of frames on the thread pool */
+    RowBitmap evaluate(const FrameStore &frames) const;
+
+    struct Node;
+
+private:
+    std::shared_ptr<const Node> root{};
+};
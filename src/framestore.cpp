@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <atomic>
+#include <QBuffer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+#include "blockcache.h"
+#include "blockcodec.h"
+#include "framestore.h"
+
+constexpr qsizetype storedAlignment = 8;
+
+template<typename T>
+static void readColumn(const uchar *&pos, QVector<T> &column, qsizetype rows)
+{
+    column.resize(rows);
+    std::memcpy(column.data(), pos, rows * sizeof(T));
+    pos += rows * sizeof(T);
+}
+
+template<typename T>
+static void writeColumn(QIODevice &device, const QVector<T> &column)
+{
+    device.write(reinterpret_cast<const char *>(column.constData()),
+                 column.size() * static_cast<qsizetype>(sizeof(T)));
+}
+
+static std::atomic<bool> compressBlocks{ false };
+
+/* Full blocks taken out of the store, packed in memory (compressed or in
+ * their stored form) until they are spilled to a temporary file, which is
+ * deleted with the last store using it. Blocks are read back through a
+ * BlockCache. */
+class PagedBlocks : public BlockSource
+{
+public:
+    ~PagedBlocks() override
+    {
+        BlockCache::instance().remove(this);
+        BlockCache::decoded().remove(this);
+    }
+
+    qsizetype memoryBytes() const
+    {
+        QMutexLocker locker(&mutex);
+        return packedBytes;
+    }
+
+    void add(qsizetype index, const FrameBlock &block, bool compress)
+    {
+        Slot slot{};
+        slot.compressed = compress;
+        if (compress) {
+            slot.packed = BlockCodec::encode(block);
+        } else {
+            QBuffer buffer(&slot.packed);
+            buffer.open(QIODevice::WriteOnly);
+            block.write(buffer);
+        }
+        slot.size = slot.packed.size();
+        slot.rows = block.size();
+        QMutexLocker locker(&mutex);
+        if (slots.size() <= index) {
+            slots.resize(index + 1);
+        }
+        packedBytes += slot.size;
+        slots[index] = std::move(slot);
+    }
+
+    /* Moves the blocks packed in memory to the spill file */
+    void spill()
+    {
+        QMutexLocker locker(&mutex);
+        if (!file.isOpen() && !file.open()) {
+            throw std::runtime_error("Cannot create spill file");
+        }
+        for (auto &slot : slots) {
+            if (slot.packed.isEmpty()) {
+                continue;
+            }
+            slot.offset = file.size();
+            file.seek(slot.offset);
+            file.write(slot.packed);
+            slot.packed = QByteArray();
+        }
+        if (file.error() != QFileDevice::NoError) {
+            throw std::runtime_error("Cannot write spill file");
+        }
+        packedBytes = 0;
+    }
+
+    std::shared_ptr<const FrameBlock> load(qsizetype index) const override
+    {
+        return cacheOf(index).get(this, index, [this, index]() {
+            QMutexLocker locker(&mutex);
+            auto slot = slots.at(index);
+            if (slot.packed.isEmpty()) {
+                file.seek(slot.offset);
+                slot.packed = file.read(slot.size);
+            }
+            locker.unlock();
+            if (slot.compressed) {
+                return BlockCodec::decode(slot.packed);
+            }
+            return FrameBlock::read(
+                    reinterpret_cast<const uchar *>(slot.packed.constData()),
+                    slot.rows);
+        });
+    }
+
+private:
+    // Blocks still packed in memory get the small cache
+    BlockCache &cacheOf(qsizetype index) const
+    {
+        QMutexLocker locker(&mutex);
+        return slots.at(index).packed.isEmpty() ? BlockCache::instance()
+                                                : BlockCache::decoded();
+    }
+
+    struct Slot
+    {
+        // Empty once spilled
+        QByteArray packed{};
+        qint64 offset{ 0 };
+        qsizetype size{ 0 };
+        qsizetype rows{ 0 };
+        bool compressed{ false };
+    };
+
+    mutable QMutex mutex;
+    mutable QTemporaryFile file;
+    QVector<Slot> slots{};
+    qsizetype packedBytes{ 0 };
+};
+
+void FrameBlock::reserve(qsizetype size)
+{
+    time.reserve(size);
+    id.reserve(size);
+    number.reserve(size);
+    channel.reserve(size);
+    dlc.reserve(size);
+    dir.reserve(size);
+    data.reserve(size);
+}
+
+void FrameBlock::append(const CanLogMsg &msg)
+{
+    time.append(msg.time);
+    id.append(msg.id);
+    number.append(msg.number);
+    channel.append(msg.channel);
+    dlc.append(msg.dlc);
+    dir.append(msg.dir);
+    data.append(msg.data);
+}
+
+CanLogMsg FrameBlock::at(qsizetype index) const
+{
+    CanLogMsg msg;
+    msg.number = number.at(index);
+    msg.id = id.at(index);
+    msg.time = time.at(index);
+    msg.channel = channel.at(index);
+    msg.dlc = dlc.at(index);
+    msg.dir = dir.at(index);
+    msg.data = data.at(index);
+    return msg;
+}
+
+TimeIndex::TimeIndex(QVector<double> samples, double maxTime, qsizetype count)
+    : highest(std::move(samples)), maxSeen(maxTime), count(count)
+{
+}
+
+void TimeIndex::append(double time)
+{
+    if (time > maxSeen) {
+        maxSeen = time;
+    }
+    if ((count & (stride - 1)) == 0) {
+        highest.append(maxSeen);
+    }
+    count++;
+}
+
+std::pair<qsizetype, qsizetype> TimeIndex::candidates(double time,
+                                                      bool inclusive) const
+{
+    auto reached = [time, inclusive](double value) {
+        return inclusive ? (value >= time) : (value > time);
+    };
+    /* The rows up to the last sample not reached are all before time, the
+     * row of the first sample reached is not */
+    auto it = std::partition_point(
+            highest.cbegin(), highest.cend(),
+            [&reached](double value) { return !reached(value); });
+    auto sample = it - highest.cbegin();
+    if (highest.isEmpty()) {
+        return { count, count };
+    }
+    if (sample == 0) {
+        return { 0, 1 };
+    }
+    auto first = ((sample - 1) << strideShift) + 1;
+    if (it == highest.cend()) {
+        return reached(maxSeen) ? std::pair{ first, count }
+                                : std::pair{ count, count };
+    }
+    return { first, (sample << strideShift) + 1 };
+}
+
+FrameStore::FrameStore(std::shared_ptr<const BlockSource> source,
+                       qsizetype count, TimeIndex timeIndex, RowIndex rowIndex)
+    : blocks(blockOf(count + blockSize - 1)),
+      timeIndex(std::move(timeIndex)),
+      source(std::move(source)),
+      rowIndex(std::move(rowIndex)),
+      count(count)
+{
+    for (auto it = this->rowIndex.cbegin(); it != this->rowIndex.cend(); ++it) {
+        idChannels[keyId(it.key())].append(keyChannel(it.key()));
+    }
+}
+
+qsizetype FrameBlock::storedSize(qsizetype rows)
+{
+    return (rows * rowBytes + storedAlignment - 1) & ~(storedAlignment - 1);
+}
+
+void FrameBlock::write(QIODevice &device) const
+{
+    writeColumn(device, time);
+    writeColumn(device, data);
+    writeColumn(device, id);
+    writeColumn(device, number);
+    writeColumn(device, channel);
+    writeColumn(device, dlc);
+    writeColumn(device, dir);
+    device.write(QByteArray(storedSize(size()) - bytes(), '\0'));
+}
+
+std::shared_ptr<FrameBlock> FrameBlock::read(const uchar *data, qsizetype rows)
+{
+    auto block = std::make_shared<FrameBlock>();
+    readColumn(data, block->time, rows);
+    readColumn(data, block->data, rows);
+    readColumn(data, block->id, rows);
+    readColumn(data, block->number, rows);
+    readColumn(data, block->channel, rows);
+    readColumn(data, block->dlc, rows);
+    readColumn(data, block->dir, rows);
+    return block;
+}
+
+void FrameStore::reserve(qsizetype size)
+{
+    blocks.reserve(blockOf(size) + 1);
+}
+
+FrameBlock &FrameStore::writableTail()
+{
+    if (count == blockStart(blocks.size())) {
+        if (!blocks.isEmpty() && blocks.last()) {
+            closeTail();
+        }
+        auto block = std::make_shared<FrameBlock>();
+        block->reserve(blockSize);
+        blocks.append(block);
+    } else if (!blocks.last()) {
+        blocks.last() = std::make_shared<FrameBlock>(*source->load(
+                blocks.size() - 1));
+    } else if (blocks.last().use_count() > 1) {
+        // Shared with a copy of this store, detach before writing
+        blocks.last() = std::make_shared<FrameBlock>(*blocks.last());
+    }
+    return *blocks.last();
+}
+
+void FrameStore::setCompression(bool enabled)
+{
+    compressBlocks = enabled;
+}
+
+bool FrameStore::compression()
+{
+    return compressBlocks;
+}
+
+bool FrameStore::pageable()
+{
+    /* Blocks of a mapped cache are not paged, and neither are those of a
+     * store whose pages are shared with a copy, the copies could store
+     * different blocks under one index */
+    if (!source) {
+        paged = std::make_shared<PagedBlocks>();
+        source = paged;
+    }
+    return paged && (paged.use_count() <= 2);
+}
+
+void FrameStore::closeTail()
+{
+    if (compression() && pageable()) {
+        paged->add(blocks.size() - 1, *blocks.last(), true);
+        blocks.last().reset();
+    } else {
+        residentBytes += blocks.last()->bytes();
+    }
+    if (memoryBytes() > BlockCache::residentLimit()) {
+        spillResident();
+    }
+}
+
+void FrameStore::spillResident()
+{
+    if (!pageable()) {
+        return;
+    }
+    for (qsizetype b = 0; b < blocks.size(); b++) {
+        if (blocks.at(b)) {
+            paged->add(b, *blocks.at(b), compression());
+            blocks[b].reset();
+        }
+    }
+    paged->spill();
+    residentBytes = 0;
+}
+
+qsizetype FrameStore::memoryBytes() const
+{
+    // Every row is in exactly one posting list
+    return residentBytes + (paged ? paged->memoryBytes() : 0)
+            + (count * static_cast<qsizetype>(sizeof(uint32_t)));
+}
+
+void FrameStore::append(const CanLogMsg &msg)
+{
+    writableTail().append(msg);
+    timeIndex.append(msg.time);
+    auto &rows = rowIndex[frameKey(msg.channel, msg.id)];
+    if (rows.isEmpty()) {
+        idChannels[msg.id].append(msg.channel);
+    }
+    rows.append(static_cast<uint32_t>(count));
+    count++;
+}
+
+QVector<uint32_t> FrameStore::rowsOfId(uint32_t id) const
+{
+    auto channels = idChannels.value(id);
+    if (channels.size() == 1) {
+        return rows(channels.first(), id);
+    }
+    QVector<uint32_t> ret{};
+    for (auto channel : channels) {
+        auto channelRows = rows(channel, id);
+        QVector<uint32_t> merged{};
+        merged.reserve(ret.size() + channelRows.size());
+        std::merge(ret.cbegin(), ret.cend(), channelRows.cbegin(),
+                   channelRows.cend(), std::back_inserter(merged));
+        ret = std::move(merged);
+    }
+    return ret;
+}
+
+qsizetype FrameStore::firstRow(double time, bool inclusive) const
+{
+    auto [first, last] = timeIndex.candidates(time, inclusive);
+    BlockPtr current{};
+    for (auto row = first; row < last; row++) {
+        if (!current || ((row & blockMask) == 0)) {
+            current = block(blockOf(row));
+        }
+        auto value = current->time.at(row & blockMask);
+        if (inclusive ? (value >= time) : (value > time)) {
+            return row;
+        }
+    }
+    return count;
+}
+
+qsizetype FrameStore::rowAtTime(double time) const
+{
+    return firstRow(time, true);
+}
+
+qsizetype FrameStore::nearestRow(double time) const
+{
+    auto row = firstRow(time, true);
+    if ((row == count)
+        || ((row > 0)
+            && (time - this->time(row - 1) < this->time(row) - time))) {
+        row--;
+    }
+    return row;
+}
+
+RowRange FrameStore::framesBetween(double t0, double t1) const
+{
+    auto first = firstRow(t0, true);
+    return { first, std::max(first, firstRow(t1, false)) };
+}
+
+double FrameStore::startTime() const
+{
+    return isEmpty() ? 0 : timeIndex.samples().first();
+}
+
+double FrameStore::endTime() const
+{
+    return isEmpty() ? 0 : timeIndex.maxTime();
+}
+
+void FrameStore::clear()
+{
+    blocks.clear();
+    timeIndex = {};
+    source.reset();
+    paged.reset();
+    residentBytes = 0;
+    rowIndex.clear();
+    idChannels.clear();
+    count = 0;
+}
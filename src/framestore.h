@@ -0,0 +1,198 @@
+#pragma once
+#include <memory>
+#include <utility>
+#include <QtNumeric>
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <QIODevice>
+#include "canmsg.h"
+
+/* Frames stored field by field, one contiguous column per field */
+struct FrameBlock
+{
+    QVector<double> time;
+    QVector<uint32_t> id;
+    QVector<uint32_t> number;
+    QVector<uint8_t> channel;
+    QVector<uint8_t> dlc;
+    QVector<uint8_t> dir;
+    QVector<CanData> data;
+
+    static constexpr qsizetype rowBytes = sizeof(double) + sizeof(CanData)
+            + (2 * sizeof(uint32_t)) + (3 * sizeof(uint8_t));
+
+    qsizetype size() const { return id.size(); }
+    qsizetype bytes() const { return size() * rowBytes; }
+    void reserve(qsizetype size);
+    void append(const CanLogMsg &msg);
+    CanLogMsg at(qsizetype index) const;
+
+    /* Stored form shared by the spill file and the trace cache: the columns
+     * one after the other, 8 byte aligned, padded to storedSize */
+    static qsizetype storedSize(qsizetype rows);
+    void write(QIODevice &device) const;
+    static std::shared_ptr<FrameBlock> read(const uchar *data, qsizetype rows);
+};
+
+/* Sparse index of the times of a store: the highest time seen up to every
+ * stride-th row. Those never decrease, so the stride holding the first row
+ * at or after a time is found by a binary search even when timestamps are
+ * slightly out of order, as some BLF loggers write them. */
+class TimeIndex
+{
+public:
+    static constexpr int strideShift = 8;
+    static constexpr qsizetype stride = qsizetype(1) << strideShift;
+
+    TimeIndex() = default;
+    TimeIndex(QVector<double> samples, double maxTime, qsizetype count);
+
+    void append(double time);
+    qsizetype size() const { return count; }
+    const QVector<double> &samples() const { return highest; }
+    double maxTime() const { return maxSeen; }
+    /* Rows [first, last) that hold the first row whose time is at or after
+     * time (after it when inclusive is false), {size, size} when no row is */
+    std::pair<qsizetype, qsizetype> candidates(double time,
+                                               bool inclusive) const;
+
+private:
+    QVector<double> highest{};
+    double maxSeen{ -qInf() };
+    qsizetype count{ 0 };
+};
+
+/* Rows [first, last) of a store */
+struct RowRange
+{
+    qsizetype first{ 0 };
+    qsizetype last{ 0 };
+
+    qsizetype size() const { return last - first; }
+    bool isEmpty() const { return last <= first; }
+};
+
+/* Provides the blocks of a store that are not resident, read from a
+ * mapped trace cache or a spill file through the BlockCache. Shared by
+ * every copy of the store and called from any thread. */
+class BlockSource
+{
+public:
+    virtual ~BlockSource() = default;
+    virtual std::shared_ptr<const FrameBlock> load(qsizetype index) const = 0;
+};
+
+class PagedBlocks;
+
+/* Column store of a whole trace. Columns are cut in fixed size blocks so
+ * the loaders can keep appending without moving the frames already stored,
+ * and scans can pin and walk one block at a time. With compression on,
+ * full blocks are kept packed by BlockCodec. Once the full blocks outgrow
+ * the BlockCache capacity they are moved to a spill file. Both are read
+ * back through the cache, so a trace of any length fits the memory limit. */
+class FrameStore
+{
+public:
+    using BlockPtr = std::shared_ptr<const FrameBlock>;
+    static constexpr int blockShift = 16;
+    static constexpr qsizetype blockSize = qsizetype(1) << blockShift;
+
+    using RowIndex = QHash<quint64, QVector<uint32_t>>;
+
+    FrameStore() = default;
+    /* Store of count frames whose blocks come from source on first use,
+     * with the time index and posting lists already known */
+    FrameStore(std::shared_ptr<const BlockSource> source, qsizetype count,
+               TimeIndex timeIndex, RowIndex rowIndex);
+
+    static qsizetype blockOf(qsizetype row) { return row >> blockShift; }
+    static qsizetype blockStart(qsizetype block)
+    {
+        return block << blockShift;
+    }
+
+    qsizetype size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    qsizetype blockCount() const { return blocks.size(); }
+    BlockPtr block(qsizetype index) const
+    {
+        const auto &resident = blocks.at(index);
+        return resident ? resident : source->load(index);
+    }
+    const TimeIndex &times() const { return timeIndex; }
+
+    CanLogMsg at(qsizetype row) const
+    {
+        return block(blockOf(row))->at(row & blockMask);
+    }
+    double time(qsizetype row) const
+    {
+        return block(blockOf(row))->time.at(row & blockMask);
+    }
+    uint32_t id(qsizetype row) const
+    {
+        return block(blockOf(row))->id.at(row & blockMask);
+    }
+    /* First row at or after time, size() when there is none. A binary
+     * search of the time index and a scan of one stride. */
+    qsizetype rowAtTime(double time) const;
+    /* Of the first row at or after time and the row before it, the one
+     * nearer to time, the later one on a tie. Rows out of order further
+     * away are not looked at. -1 when the store is empty. */
+    qsizetype nearestRow(double time) const;
+    /* Rows from the first at or after t0 up to the first after t1 */
+    RowRange framesBetween(double t0, double t1) const;
+    /* Time span of the trace, without reading any block */
+    double startTime() const;
+    double endTime() const;
+
+    /* Posting lists: sorted rows of every (channel, id) pair, filled while
+     * frames are appended */
+    static quint64 frameKey(uint8_t channel, uint32_t id)
+    {
+        return (static_cast<quint64>(channel) << 32) | id;
+    }
+    static uint8_t keyChannel(quint64 key)
+    {
+        return static_cast<uint8_t>(key >> 32);
+    }
+    static uint32_t keyId(quint64 key) { return static_cast<uint32_t>(key); }
+    QList<quint64> frameKeys() const { return rowIndex.keys(); }
+    QVector<uint32_t> rows(uint8_t channel, uint32_t id) const
+    {
+        return rowIndex.value(frameKey(channel, id));
+    }
+    QVector<uint32_t> rowsOfId(uint32_t id) const;
+
+    void reserve(qsizetype size);
+    void append(const CanLogMsg &msg);
+    void clear();
+    /* Bytes held in memory by the full blocks and the posting lists, which
+     * are spilled once over BlockCache::residentLimit() */
+    qsizetype memoryBytes() const;
+
+    /* Packs the blocks of stores filled from now on */
+    static void setCompression(bool enabled);
+    static bool compression();
+
+private:
+    static constexpr qsizetype blockMask = blockSize - 1;
+    FrameBlock &writableTail();
+    qsizetype firstRow(double time, bool inclusive) const;
+    bool pageable();
+    void closeTail();
+    void spillResident();
+
+    // Null for the blocks still held by source
+    QVector<std::shared_ptr<FrameBlock>> blocks{};
+    TimeIndex timeIndex{};
+    std::shared_ptr<const BlockSource> source{};
+    // Same object as source once blocks were packed or spilled
+    std::shared_ptr<PagedBlocks> paged{};
+    // Full blocks left as they are
+    qsizetype residentBytes{ 0 };
+    RowIndex rowIndex{};
+    QHash<uint32_t, QVector<uint8_t>> idChannels{};
+    qsizetype count{ 0 };
+};
@@ -1,43 +1,167 @@
 #include <stdexcept>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <string_view>
 #include "logparser.h"
 #include <QFile>
-#include <QTextStream>
 #include <QRegularExpression>
 #include <QDebug>
-#include <QScopedPointer>
+#include <QtConcurrent>
 #include "blfparser.h"
 
-class TextDriver
+/* Hex digit values, -1 for anything else */
+static constexpr std::array<int8_t, 256> hexTable = [] {
+    std::array<int8_t, 256> table{};
+    for (auto &t : table) {
+        t = -1;
+    }
+    for (int i = 0; i < 10; i++) {
+        table['0' + i] = static_cast<int8_t>(i);
+    }
+    for (int i = 0; i < 6; i++) {
+        table['A' + i] = static_cast<int8_t>(10 + i);
+        table['a' + i] = static_cast<int8_t>(10 + i);
+    }
+    return table;
+}();
+
+/* Splits a line into whitespace separated tokens without copying it */
+class LineScanner
 {
 public:
-    virtual bool parseLine(const QString &line, CanLogMsg &msg) = 0;
-    QVector<CanLogMsg> parse(const QString &name)
+    LineScanner(const char *begin, const char *end) : pos(begin), end(end) { }
+
+    std::string_view next()
+    {
+        while ((pos != end) && ((*pos == ' ') || (*pos == '\t'))) {
+            pos++;
+        }
+        auto *start = pos;
+        while ((pos != end) && (*pos != ' ') && (*pos != '\t')) {
+            pos++;
+        }
+        return { start, static_cast<size_t>(pos - start) };
+    }
+
+    template<typename T>
+    static bool parseUInt(std::string_view token, T &value)
+    {
+        auto *last = token.data() + token.size();
+        auto [ptr, ec] = std::from_chars(token.data(), last, value);
+        return (ec == std::errc()) && (ptr == last);
+    }
+
+    static bool parseHex(std::string_view token, uint32_t &value)
+    {
+        if (token.empty() || (token.size() > extCanNibble)) {
+            return false;
+        }
+        value = 0;
+        for (auto c : token) {
+            auto digit = hexTable[static_cast<uint8_t>(c)];
+            if (digit < 0) {
+                return false;
+            }
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        return true;
+    }
+
+    static bool parseHexByte(std::string_view token, uint8_t &value)
+    {
+        if (token.size() != 2) {
+            return false;
+        }
+        auto high = hexTable[static_cast<uint8_t>(token[0])];
+        auto low = hexTable[static_cast<uint8_t>(token[1])];
+        if ((high < 0) || (low < 0)) {
+            return false;
+        }
+        value = static_cast<uint8_t>((high << 4) | low);
+        return true;
+    }
+
+    /* Plain <digits>[.<digits>] numbers, as written by CAN loggers. The
+     * whole token is converted at once, rounded like the toDouble() of the
+     * regex fallback. */
+    static bool parseDecimal(std::string_view token, double &value)
+    {
+        if (token.empty() || (token.front() < '0') || (token.front() > '9')) {
+            return false;
+        }
+        auto *last = token.data() + token.size();
+        auto [ptr, ec] = std::from_chars(token.data(), last, value,
+                                         std::chars_format::fixed);
+        return (ec == std::errc()) && (ptr == last);
+    }
+
+    static bool parseDir(std::string_view token, uint8_t &dir)
     {
-        QFile file(name);
-        if (!file.open(QFile::ReadOnly | QFile::Text)) {
-            throw std::runtime_error("Cannot open file");
+        if (token == "Rx") {
+            dir = CAN_DIR_RX;
+            return true;
         }
-        QTextStream in(&file);
-        auto ret = parse(in);
-        file.close();
-        return std::move(ret);
+        if (token == "Tx") {
+            dir = CAN_DIR_TX;
+            return true;
+        }
+        return false;
     }
 
-    QVector<CanLogMsg> parse(QTextStream &in)
+private:
+    const char *pos;
+    const char *end;
+};
+
+class TextDriver
+{
+public:
+    /* Regular expression parser, used for lines the scanner rejects */
+    virtual bool parseLine(const QString &line, CanLogMsg &msg) = 0;
+    /* Allocation free parser working on the raw bytes of a line */
+    virtual bool scanLine(const char *begin, const char *end,
+                          CanLogMsg &msg) = 0;
+
+    QVector<CanLogMsg> parse(const char *begin, const char *end)
     {
         QVector<CanLogMsg> messages{};
-        while (!in.atEnd()) {
-            CanLogMsg msg;
-            auto line = in.readLine();
-            auto result = parseLine(line, msg);
-            if (result) {
-                messages.append(msg);
+        messages.reserve((end - begin) / averageLineSize);
+        while (begin < end) {
+            auto *eol = static_cast<const char *>(
+                    std::memchr(begin, '\n', end - begin));
+            if (eol == nullptr) {
+                eol = end;
             }
+            auto *last = eol;
+            if ((last != begin) && (last[-1] == '\r')) {
+                last--;
+            }
+            if (last != begin) {
+                CanLogMsg msg;
+                if (scanLine(begin, last, msg)) {
+                    messages.append(msg);
+                } else {
+                    msg = CanLogMsg();
+                    auto line = QString::fromUtf8(begin, last - begin);
+                    if (parseLine(line, msg)) {
+                        messages.append(msg);
+                    }
+                }
+            }
+            begin = eol + 1;
         }
         return std::move(messages);
     }
+    /* True when the driver numbers frames itself with a running counter,
+     * which then restarts in every chunk */
+    static constexpr bool countsMessages = false;
+
     TextDriver() = default;
     virtual ~TextDriver() = default;
+
+private:
+    static constexpr int averageLineSize = 64;
 };
 
 // ;$FILEVERSION=1.1
@@ -107,7 +231,36 @@ public:
         result = match.captured(dataOffset);
         result.remove(" ");
         auto data = QByteArray::fromHex(result.toUtf8());
-        std::memcpy(msg.data.data(), data.constData(), data.size());
+        std::memcpy(msg.data.data(), data.constData(),
+                    std::min<qsizetype>(data.size(), CAN_MAX_DLC));
+        msg.channel = 0;
+        return true;
+    }
+
+    bool scanLine(const char *begin, const char *end, CanLogMsg &msg) override
+    {
+        LineScanner in(begin, end);
+        auto token = in.next();
+        if (token.empty() || (token.back() != ')')
+            || !LineScanner::parseUInt(token.substr(0, token.size() - 1),
+                                       msg.number)) {
+            return false;
+        }
+        if (!LineScanner::parseDecimal(in.next(), msg.time)) {
+            return false;
+        }
+        msg.time /= timeScale;
+        if (!LineScanner::parseDir(in.next(), msg.dir)
+            || !LineScanner::parseHex(in.next(), msg.id)
+            || !LineScanner::parseUInt(in.next(), msg.dlc)
+            || (msg.dlc > CAN_MAX_DLC)) {
+            return false;
+        }
+        for (int i = 0; i < msg.dlc; i++) {
+            if (!LineScanner::parseHexByte(in.next(), msg.data[i])) {
+                return false;
+            }
+        }
         msg.channel = 0;
         return true;
     }
@@ -166,11 +319,50 @@ public:
         result = match.captured(dataOffset);
         result.remove(" ");
         auto data = QByteArray::fromHex(result.toUtf8());
-        std::memcpy(msg.data.data(), data.constData(), data.size());
+        std::memcpy(msg.data.data(), data.constData(),
+                    std::min<qsizetype>(data.size(), CAN_MAX_DLC));
         number += 1;
         return true;
     }
 
+    bool scanLine(const char *begin, const char *end, CanLogMsg &msg) override
+    {
+        LineScanner in(begin, end);
+        if (!LineScanner::parseDecimal(in.next(), msg.time)) {
+            return false;
+        }
+        // The channel column is optional
+        auto idToken = in.next();
+        auto dirToken = in.next();
+        if (!LineScanner::parseDir(dirToken, msg.dir)) {
+            if (!LineScanner::parseUInt(idToken, msg.channel)) {
+                return false;
+            }
+            idToken = dirToken;
+            if (!LineScanner::parseDir(in.next(), msg.dir)) {
+                return false;
+            }
+        }
+        if (!idToken.empty() && (idToken.back() == 'x')) {
+            idToken.remove_suffix(1);
+        }
+        if (!LineScanner::parseHex(idToken, msg.id) || (in.next() != "d")
+            || !LineScanner::parseUInt(in.next(), msg.dlc)
+            || (msg.dlc > CAN_MAX_DLC)) {
+            return false;
+        }
+        for (int i = 0; i < msg.dlc; i++) {
+            if (!LineScanner::parseHexByte(in.next(), msg.data[i])) {
+                return false;
+            }
+        }
+        msg.number = number;
+        number += 1;
+        return true;
+    }
+
+    static constexpr bool countsMessages = true;
+
 private:
     static constexpr uint8_t timeOffset = 1;
     static constexpr uint8_t chanOffset = 2;
@@ -182,6 +374,65 @@ private:
     QRegularExpression re;
 };
 
+struct TextChunk
+{
+    const char *begin;
+    const char *end;
+};
+
+/* Splits the file in large chunks on line borders, parses each chunk on the
+ * thread pool with its own driver and appends the results in file order */
+template<typename Driver>
+static FrameStore parseText(const QString &name, qsizetype chunkSize)
+{
+    QFile file(name);
+    if (!file.open(QFile::ReadOnly)) {
+        throw std::runtime_error("Cannot open file");
+    }
+    auto size = file.size();
+    const auto *raw = reinterpret_cast<const char *>(file.map(0, size));
+    QByteArray fallback{};
+    if (raw == nullptr) {
+        fallback = file.readAll();
+        raw = fallback.constData();
+        size = fallback.size();
+    }
+
+    QVector<TextChunk> chunks{};
+    const auto *end = raw + size;
+    const auto *begin = raw;
+    while (begin < end) {
+        const auto *stop = end;
+        if (end - begin > chunkSize) {
+            stop = static_cast<const char *>(
+                    std::memchr(begin + chunkSize, '\n',
+                                end - begin - chunkSize));
+            stop = (stop == nullptr) ? end : stop + 1;
+        }
+        chunks.append(TextChunk{ begin, stop });
+        begin = stop;
+    }
+
+    auto messages = QtConcurrent::blockingMappedReduced<FrameStore>(
+            chunks,
+            [](const TextChunk &chunk) {
+                Driver driver;
+                return driver.parse(chunk.begin, chunk.end);
+            },
+            [](FrameStore &result, const QVector<CanLogMsg> &part) {
+                auto offset = static_cast<uint32_t>(result.size());
+                for (auto msg : part) {
+                    if (Driver::countsMessages) {
+                        msg.number += offset;
+                    }
+                    result.append(msg);
+                }
+            },
+            QtConcurrent::OrderedReduce | QtConcurrent::SequentialReduce);
+    file.close();
+    return std::move(messages);
+}
+
 QString getExtension(const QString &name)
 {
     auto lastDotIndex = name.lastIndexOf('.');
@@ -191,25 +442,18 @@ QString getExtension(const QString &name)
     return "";
 }
 
-QVector<CanLogMsg> Parser::parse(const QString &name)
+FrameStore Parser::parse(const QString &name, qsizetype chunkSize)
 {
-    std::unique_ptr<TextDriver> driver;
     auto extension = getExtension(name);
-    bool isText = true;
     if (extension.compare("asc", Qt::CaseInsensitive) == 0) {
         // ASC file
-        driver = std::make_unique<AscDriver>();
+        return parseText<AscDriver>(name, chunkSize);
     } else if (extension.compare("trc", Qt::CaseInsensitive) == 0) {
         // Trc file
-        driver = std::make_unique<TrcDriver>();
+        return parseText<TrcDriver>(name, chunkSize);
     } else if (extension.compare("blf", Qt::CaseInsensitive) == 0) {
-        isText = false;
-    }
-
-    if (isText) {
-        return driver->parse(name);
-    } else {
         BlfParser parser;
         return parser.parse(name);
     }
+    throw std::runtime_error("Unexpected format");
 }
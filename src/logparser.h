@@ -1,10 +1,15 @@
 #pragma once
 #include <QString>
 #include <QVector>
-#include "canmsg.h"
+#include "framestore.h"
 
 class Parser
 {
 public:
-    static QVector<CanLogMsg> parse(const QString &name);
+    /* Text logs are cut in chunks of about chunkSize bytes, parsed in
+     * parallel */
+    static constexpr qsizetype defaultChunkSize = 8 * 1024 * 1024;
+
+    static FrameStore parse(const QString &name,
+                            qsizetype chunkSize = defaultChunkSize);
 };
@@ -5,6 +5,9 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    // Names the settings and the cache directory
+    QCoreApplication::setOrganizationName("can-tracer");
+    QCoreApplication::setApplicationName("can-tracer");
     MainWindow w;
     w.show();
     return a.exec();
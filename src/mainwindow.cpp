@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
@@ -9,22 +10,37 @@
 #include <QtConcurrent>
 #include <QFuture>
 #include <QInputDialog>
-#include <QChart>
-#include <QChartView>
-#include <QLineSeries>
-#include <QGraphicsLayout>
-#include <QValueAxis>
-#include "logparser.h"
+#include <QColorDialog>
+#include <QSettings>
+#include "blockcache.h"
+#include "tracecache.h"
+#include "payloadsearch.h"
+#include "busload.h"
 #include "canlogmodel.h"
 #include "dbcparser.h"
 #include "signalselectdialog.h"
-#include "customqchartview.h"
 
+/* Column widths measured on rows spread over the model, measuring every
+ * row of a trace would format all of them */
 template<typename T>
 void resizeColumns(T view)
 {
-    for (int i = 0; i < view->model()->columnCount(); i++) {
-        view->resizeColumnToContents(i);
+    constexpr int sampleRows = 200;
+    constexpr int padding = 12;
+    auto *model = view->model();
+    auto rows = model->rowCount();
+    auto step = std::max(rows / sampleRows, 1);
+    auto metrics = view->fontMetrics();
+    for (int column = 0; column < model->columnCount(); column++) {
+        auto width = view->header()->sectionSizeHint(column);
+        for (int row = 0; row < rows; row += step) {
+            auto text = model->data(model->index(row, column, {})).toString();
+            width = std::max(width, metrics.horizontalAdvance(text) + padding);
+        }
+        if (column == 0) {
+            width += view->indentation();
+        }
+        view->setColumnWidth(column, width);
     }
 }
 
@@ -32,14 +48,16 @@ MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       ui(new Ui::MainWindow),
       msgDb({}),
-      log({}),
+      log(),
       model(log, msgDb, this),
       proxyModel(this),
       msgModel(msgDb, this),
       plotModel(this),
       signalModel(msgDb, this),
       colorDelegate(this),
-      logDelegate(this)
+      logDelegate(this),
+      statsModel(msgDb, this),
+      statsProxy(this)
 {
     ui->setupUi(this);
 
@@ -50,8 +68,26 @@ MainWindow::MainWindow(QWidget *parent)
     proxyModel.setSourceModel(&model);
     ui->tblLog->setModel(&proxyModel);
     ui->tblLog->setItemDelegate(&logDelegate);
+    // A filter or sort result moves the rows, the current frame stays shown
+    connect(&proxyModel, &QAbstractItemModel::layoutChanged, this, [this]() {
+        auto current = ui->tblLog->currentIndex();
+        if (current.isValid()) {
+            ui->tblLog->scrollTo(current, QAbstractItemView::PositionAtCenter);
+        }
+    });
     ui->tblLog->show();
     ui->viewSignal->setModel(&signalModel);
+    statsProxy.setSourceModel(&statsModel);
+    statsProxy.setSortRole(Qt::UserRole);
+    ui->viewStats->setModel(&statsProxy);
+    ui->viewStats->sortByColumn(-1, Qt::AscendingOrder);
+    for (auto bucket : { 0.001, 0.01, 0.1, 1.0 }) {
+        auto label = (bucket < 1) ? tr("%1 ms").arg(bucket * 1000)
+                                  : tr("%1 s").arg(bucket);
+        ui->comboBucket->addItem(label, bucket);
+    }
+    ui->comboBucket->setCurrentIndex(2);
+    ui->spinBitrate->setValue(BusLoad::defaultBitrate / 1000);
     resizeColumns(ui->tblLog);
 
     ui->viewMsg->setItemDelegate(&colorDelegate);
@@ -59,10 +95,13 @@ MainWindow::MainWindow(QWidget *parent)
     ui->viewMsg->show();
     resizeColumns(ui->viewMsg);
 
-    ui->graphlayout->setContentsMargins(0, 0, 0, 0);
-    ui->graphlayout->setSpacing(0);
+    updateChartAxis();
 
     ui->tblLog->setUniformRowHeights(true);
+    // Start in log order, a third click on a header returns to it
+    ui->tblLog->header()->setSortIndicator(-1, Qt::AscendingOrder);
+    ui->tblLog->header()->setSortIndicatorClearable(true);
+    ui->tblLog->setSortingEnabled(true);
     ui->viewMsg->setUniformRowHeights(true);
     ui->viewSignalPlot->setUniformItemSizes(true);
 
@@ -75,37 +114,85 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->btnZoomOutX, SIGNAL(clicked()), this, SLOT(onZoomOutX()));
     connect(ui->btnZoomOutY, SIGNAL(clicked()), this, SLOT(onZoomOutY()));
     connect(ui->btnResetAll, SIGNAL(clicked()), this, SLOT(onResetAllAxis()));
+    connect(ui->btnBusLoad, &QPushButton::clicked, this,
+            &MainWindow::onAddBusLoad);
     connect(ui->actionOpen, SIGNAL(triggered()), this, SLOT(openFile()));
     connect(ui->btnOpen, SIGNAL(clicked()), this, SLOT(openFile()));
     connect(ui->actionOpenDbc, SIGNAL(triggered()), this, SLOT(openDbcFile()));
     connect(ui->btnOpenDbc, SIGNAL(clicked()), this, SLOT(openDbcFile()));
+    connect(ui->actionGoToTime, &QAction::triggered, this,
+            &MainWindow::onGoToTime);
+    connect(ui->actionMemoryLimit, &QAction::triggered, this,
+            &MainWindow::onSetMemoryLimit);
+    connect(ui->actionCompressFrames, &QAction::toggled, this,
+            &MainWindow::onCompressFrames);
     connect(ui->tblLog, SIGNAL(customContextMenuRequested(QPoint)), this,
             SLOT(onContextMenu(const QPoint &)));
     connect(ui->tblLog->header(), SIGNAL(customContextMenuRequested(QPoint)),
             this, SLOT(onHeaderContextMenu(const QPoint &)));
+    connect(ui->lineFilter, &QLineEdit::returnPressed, this,
+            &MainWindow::onFilterEdited);
+    connect(ui->lineSearch, &QLineEdit::returnPressed, this,
+            &MainWindow::onSearch);
+    connect(ui->lineSearchId, &QLineEdit::returnPressed, this,
+            &MainWindow::onSearch);
+    connect(ui->lineSearchChan, &QLineEdit::returnPressed, this,
+            &MainWindow::onSearch);
+    for (auto *edit : { ui->lineSearch, ui->lineSearchId, ui->lineSearchChan }) {
+        // Hits of an edited search are stale, the next jump searches again
+        connect(edit, &QLineEdit::textChanged, this, [this]() {
+            searchHits.clear();
+            ui->labelSearchHits->clear();
+        });
+    }
+    connect(ui->btnSearchNext, &QPushButton::clicked, this,
+            &MainWindow::onSearchNext);
+    connect(ui->btnSearchPrev, &QPushButton::clicked, this,
+            &MainWindow::onSearchPrev);
+    connect(ui->lineFilter, &QLineEdit::textChanged, this,
+            [this](const QString &text) {
+                if (text.isEmpty()) {
+                    onFilterEdited();
+                }
+            });
     connect(ui->viewSignalPlot, SIGNAL(customContextMenuRequested(QPoint)),
             this, SLOT(onSignalPlotMenu(const QPoint &)));
     connect(&logWatcher, &decltype(logWatcher)::finished, this,
             &MainWindow::onLoadLogFile);
     connect(&dbcWatcher, &decltype(dbcWatcher)::finished, this,
             &MainWindow::onLoadDbcFile);
+    connect(&statsWatcher, &decltype(statsWatcher)::finished, this,
+            &MainWindow::onStatsReady);
     connect(ui->viewMsg, SIGNAL(clicked(QModelIndex)), this,
             SLOT(onMsgSelect(QModelIndex)));
+    connect(ui->plotWidget, &SignalPlotWidget::pointNotify, this,
+            &MainWindow::onPointNotify);
+    connect(ui->plotWidget, &SignalPlotWidget::cursorMoved, this,
+            &MainWindow::onPlotCursor);
+    connect(ui->tblLog->selectionModel(),
+            &QItemSelectionModel::currentRowChanged, this,
+            &MainWindow::onLogCurrentChanged);
+    // The log table follows the plot cursor at most once per frame
+    cursorTimer.setSingleShot(true);
+    cursorTimer.setInterval(cursorSyncInterval);
+    connect(&cursorTimer, &QTimer::timeout, this,
+            [this]() { selectLogRowAt(cursorTime); });
+
+    QSettings settings;
+    auto limit = settings.value(memoryLimitKey,
+                                BlockCache::defaultMemoryLimit / bytesPerMiB)
+                         .toLongLong();
+    BlockCache::setMemoryLimit(limit * bytesPerMiB);
+    ui->actionCompressFrames->setChecked(
+            settings.value(compressFramesKey, false).toBool());
 }
 
 void MainWindow::updateChartAxis()
 {
-    for (int i = 0; i < plotModel.rowCount(); i++) {
-        auto *chartView = plotModel.getChartAt(i);
-        chartView->setMinimumWidth(static_cast<int>(time * widthPerSec));
-        chartView->setMinimumHeight(minChartSize);
-        auto *chart = chartView->chart();
-        auto ax = chart->axes(Qt::Horizontal);
-        dynamic_cast<QValueAxis *>(ax[0])->setTickCount(
-                static_cast<int>(time * tickPerSec));
-        ax = chart->axes(Qt::Vertical);
-        dynamic_cast<QValueAxis *>(ax[0])->setTickCount(yTick);
-    }
+    ui->plotWidget->setPixelsPerSecond(widthPerSec);
+    ui->plotWidget->setLaneHeight(minChartSize);
+    ui->plotWidget->setXTicksPerSecond(tickPerSec);
+    ui->plotWidget->setYTicks(yTick);
 }
 
 MainWindow::~MainWindow()
@@ -132,7 +219,7 @@ void MainWindow::openFile()
     }
     ui->lineLogPath->setText(fileName);
     logFuture = QtConcurrent::run(
-            [fileName, this]() { return std::move(Parser::parse(fileName)); });
+            [fileName]() { return TraceCache::open(fileName); });
     logWatcher.setFuture(logFuture);
     ui->statusbar->showMessage(tr("Loading..."));
 }
@@ -152,6 +239,33 @@ void MainWindow::openDbcFile()
     dbcWatcher.setFuture(dbcFuture);
 }
 
+void MainWindow::onSetMemoryLimit()
+{
+    bool ok = false;
+    auto current = BlockCache::memoryLimit() / bytesPerMiB;
+    auto limit = QInputDialog::getInt(
+            this, tr("Memory limit"),
+            tr("Memory for frames (MiB). Three quarters hold the frames and\n"
+               "their index, larger traces are spilled to disk. One quarter\n"
+               "caches the frames read back from disk:"),
+            static_cast<int>(current), minMemoryLimit, maxMemoryLimit,
+            minMemoryLimit, &ok);
+    if (!ok) {
+        return;
+    }
+    BlockCache::setMemoryLimit(limit * bytesPerMiB);
+    QSettings settings;
+    settings.setValue(memoryLimitKey, limit);
+}
+
+void MainWindow::onCompressFrames(bool enabled)
+{
+    // Takes effect with the next trace loaded
+    FrameStore::setCompression(enabled);
+    QSettings settings;
+    settings.setValue(compressFramesKey, enabled);
+}
+
 void MainWindow::onContextMenu(const QPoint &point)
 {
     auto index = ui->tblLog->indexAt(point);
@@ -187,12 +301,143 @@ void MainWindow::onContextMenu(const QPoint &point)
             });
         }
 
+        auto *ruleAction = new QAction(tr("Add highlight rule..."), menu);
+        connect(ruleAction, &QAction::triggered, this,
+                &MainWindow::onAddHighlightRule);
+
         menu->addAction(msgAction);
         menu->addAction(idAction);
+        menu->addSeparator();
+        menu->addAction(ruleAction);
+        if (model.highlightRuleCount() > 0) {
+            auto *clearAction = new QAction(tr("Clear highlight rules"), menu);
+            connect(clearAction, &QAction::triggered, this,
+                    [this]() { model.clearHighlightRules(); });
+            menu->addAction(clearAction);
+        }
         menu->popup(ui->tblLog->viewport()->mapToGlobal(point));
     }
 }
 
+void MainWindow::onSearch()
+{
+    searchHits.clear();
+    ui->labelSearchHits->clear();
+    if (ui->lineSearch->text().trimmed().isEmpty()) {
+        return;
+    }
+    try {
+        auto search = PayloadSearch::compile(ui->lineSearch->text());
+        auto ok = false;
+        auto idText = ui->lineSearchId->text().trimmed();
+        if (!idText.isEmpty()) {
+            auto id = idText.toUInt(&ok, 16);
+            if (!ok) {
+                throw std::runtime_error("Invalid ID");
+            }
+            search.setId(id);
+        }
+        auto chanText = ui->lineSearchChan->text().trimmed();
+        if (!chanText.isEmpty()) {
+            auto channel = chanText.toUInt(&ok);
+            if (!ok || (channel > UINT8_MAX)) {
+                throw std::runtime_error("Invalid channel");
+            }
+            search.setChannel(static_cast<uint8_t>(channel));
+        }
+        searchHits = search.find(log);
+    } catch (const std::runtime_error &e) {
+        ui->statusbar->showMessage(tr("Search: %1").arg(e.what()));
+        return;
+    }
+    ui->statusbar->clearMessage();
+    ui->labelSearchHits->setText(tr("%1 hits").arg(searchHits.size()));
+    jumpToHit(true);
+}
+
+void MainWindow::onSearchNext()
+{
+    if (searchHits.isEmpty()) {
+        onSearch();
+    } else {
+        jumpToHit(true);
+    }
+}
+
+void MainWindow::onSearchPrev()
+{
+    if (searchHits.isEmpty()) {
+        onSearch();
+    } else {
+        jumpToHit(false);
+    }
+}
+
+void MainWindow::jumpToHit(bool forward)
+{
+    if (searchHits.isEmpty()) {
+        return;
+    }
+    auto current = proxyModel.mapToSource(ui->tblLog->currentIndex());
+    if (current.parent().isValid()) {
+        current = current.parent();
+    }
+    qsizetype row = forward ? -1 : log.size();
+    if (current.isValid()) {
+        row = current.row();
+    }
+    // Hits in log order from the current row on, skipping filtered ones
+    auto it = std::upper_bound(
+            searchHits.cbegin(), searchHits.cend(), row,
+            [](qsizetype r, uint32_t hit) { return r < qsizetype(hit); });
+    if (!forward) {
+        it = std::lower_bound(
+                searchHits.cbegin(), searchHits.cend(), row,
+                [](uint32_t hit, qsizetype r) { return qsizetype(hit) < r; });
+    }
+    while (forward ? (it != searchHits.cend()) : (it != searchHits.cbegin())) {
+        if (!forward) {
+            it--;
+        }
+        auto index = proxyModel.mapFromSource(
+                model.index(static_cast<int>(*it), 0, {}));
+        if (index.isValid()) {
+            ui->tblLog->setCurrentIndex(index);
+            ui->tblLog->scrollTo(index, QAbstractItemView::PositionAtCenter);
+            ui->labelSearchHits->setText(
+                    tr("%1 / %2")
+                            .arg(it - searchHits.cbegin() + 1)
+                            .arg(searchHits.size()));
+            return;
+        }
+        if (forward) {
+            it++;
+        }
+    }
+    ui->statusbar->showMessage(tr("No more hits"));
+}
+
+void MainWindow::onAddHighlightRule()
+{
+    bool ok = false;
+    auto text = QInputDialog::getText(
+            this, tr("Highlight rule"),
+            tr("Frames matching, e.g. dlc < 8 && chan == 2"),
+            QLineEdit::Normal, {}, &ok);
+    if (!ok || text.trimmed().isEmpty()) {
+        return;
+    }
+    auto color = QColorDialog::getColor(Qt::cyan, this, tr("Highlight color"));
+    if (!color.isValid()) {
+        return;
+    }
+    try {
+        model.addHighlightRule(text, color);
+    } catch (const std::runtime_error &e) {
+        ui->statusbar->showMessage(tr("Highlight rule: %1").arg(e.what()));
+    }
+}
+
 void MainWindow::onHeaderContextMenu(const QPoint &point)
 {
     auto index = ui->tblLog->header()->logicalIndexAt(point);
@@ -206,6 +451,16 @@ void MainWindow::onHeaderContextMenu(const QPoint &point)
     }
 }
 
+void MainWindow::onFilterEdited()
+{
+    try {
+        proxyModel.setFilterExpression(ui->lineFilter->text());
+        ui->statusbar->clearMessage();
+    } catch (const std::runtime_error &e) {
+        ui->statusbar->showMessage(tr("Filter: %1").arg(e.what()));
+    }
+}
+
 void MainWindow::onSignalPlotMenu(const QPoint &point)
 {
     if (msgDb.messageCount() == 0) {
@@ -229,14 +484,23 @@ void MainWindow::onSignalPlotMenu(const QPoint &point)
 void MainWindow::onLoadLogFile()
 {
     ui->statusbar->clearMessage();
-    log = std::move(logFuture.result());
+    log = logFuture.result();
+    searchHits.clear();
+    ui->labelSearchHits->clear();
     model.logChanged();
     resizeColumns(ui->tblLog);
     plotModel.reset();
-    if (log.size() != 0) {
-        auto delta = abs(log[0].time - log[log.size() - 1].time);
-        time = delta;
-    }
+    ui->plotWidget->clear();
+    signalCache.reset(log, msgDb);
+    statsModel.setStats({});
+    statsWatcher.setFuture(QtConcurrent::run(
+            [frames = log]() { return TraceStats::compute(frames); }));
+}
+
+void MainWindow::onStatsReady()
+{
+    statsModel.setStats(statsWatcher.result());
+    resizeColumns(ui->viewStats);
 }
 
 void MainWindow::onLoadDbcFile()
@@ -244,7 +508,9 @@ void MainWindow::onLoadDbcFile()
     msgDb = dbcFuture.result();
     model.dbChanged();
     msgModel.dbChanged();
+    statsModel.dbChanged();
     signalModel.dbChanged();
+    signalCache.reset(log, msgDb);
     resizeColumns(ui->viewMsg);
 }
 
@@ -263,47 +529,32 @@ void MainWindow::onAddSignal(QModelIndex)
     auto pair = dialog.getResultIndex();
     auto msg = msgDb.at(pair.first);
     auto signal = msg.canSignals.at(pair.second);
-    auto data = CanSignal::getSignalGraph(signal, msg.id, log);
-    /* These pointers will be free with the chart widget */
-    auto *series = new QLineSeries();
-    if (data.size() < 3) {
-        // Draw all
-        for (auto d : data) {
-            series->append(d.first, d.second);
-        }
-    } else {
-        // Only draw important points
-        int index = 0;
-        series->append(data[index].first, data[index].second);
-        for (index = 1; index < data.size() - 1; index++) {
-            if ((data[index].second != data[index - 1].second)
-                || (data[index].second != data[index + 1].second)) {
-                series->append(data[index].first, data[index].second);
-            }
-        }
-        series->append(data[index].first, data[index].second);
-    }
-    auto *chart = new QChart();
-    chart->legend()->hide();
-    chart->setTitle(signal.name);
-    chart->addSeries(series);
-    chart->createDefaultAxes();
-    chart->setContentsMargins(0, 0, 0, 0);
-    chart->setBackgroundRoundness(0);
-    auto ax = chart->axes(Qt::Horizontal, series);
-    dynamic_cast<QValueAxis *>(ax[0])->setTickCount(
-            static_cast<int>(time * tickPerSec));
-    ax = chart->axes(Qt::Vertical, series);
-    dynamic_cast<QValueAxis *>(ax[0])->setTickCount(yTick);
-    auto *chartView = new CustomQChartView(chart, signal);
-    connect(chartView, SIGNAL(pointNotify(QString)), this,
-            SLOT(onPointNotify(QString)));
-    chartView->setMinimumWidth(static_cast<int>(time * widthPerSec));
-    chartView->setMinimumHeight(minChartSize);
-    chartView->setContentsMargins(0, 0, 0, 0);
-    chart->layout()->setContentsMargins(0, 0, 0, 0);
-    ui->graphlayout->addWidget(chartView);
-    plotModel.addItem(msg.id, signal, chartView);
+    auto data = signalCache.graph(signal, msg.id);
+    ui->plotWidget->addLane(msg.id, signal, data);
+    plotModel.addItem(msg.id, signal);
+}
+
+void MainWindow::onAddBusLoad()
+{
+    auto bitrate = ui->spinBitrate->value() * 1000;
+    auto bucket = ui->comboBucket->currentData().toDouble();
+    QMap<uint8_t, SignalGraph> graphs{};
+    try {
+        graphs = BusLoad::compute(log, bitrate, bucket);
+    } catch (const std::runtime_error &e) {
+        ui->statusbar->showMessage(tr("Bus load: %1").arg(e.what()));
+        return;
+    }
+    for (auto it = graphs.cbegin(); it != graphs.cend(); it++) {
+        CanSignal signal{};
+        signal.name = tr("Bus load chan %1 (%2, %3 kbit/s)")
+                              .arg(it.key())
+                              .arg(ui->comboBucket->currentText())
+                              .arg(bitrate / 1000);
+        signal.unit = "%";
+        ui->plotWidget->addLane(noCanId, signal, it.value());
+        plotModel.addItem(noCanId, signal);
+    }
 }
 
 void MainWindow::onPointNotify(QString label)
@@ -311,8 +562,69 @@ void MainWindow::onPointNotify(QString label)
     ui->statusbar->showMessage(label);
 }
 
+void MainWindow::onPlotCursor(double time)
+{
+    cursorTime = time;
+    if (!cursorTimer.isActive()) {
+        cursorTimer.start();
+    }
+}
+
+bool MainWindow::selectLogRowAt(double time)
+{
+    auto row = log.nearestRow(time);
+    if (row < 0) {
+        return false;
+    }
+    auto index = proxyModel.mapFromSource(
+            model.index(static_cast<int>(row), 0, {}));
+    if (!index.isValid()) {
+        // Filtered out
+        return false;
+    }
+    followingCursor = true;
+    ui->tblLog->setCurrentIndex(index);
+    ui->tblLog->scrollTo(index, QAbstractItemView::PositionAtCenter);
+    followingCursor = false;
+    return true;
+}
+
+void MainWindow::onGoToTime()
+{
+    if (log.isEmpty()) {
+        return;
+    }
+    bool ok = false;
+    auto time = QInputDialog::getDouble(
+            this, tr("Go to time"), tr("Time (s):"), cursorTime,
+            log.startTime(), log.endTime(), goToTimeDecimals, &ok);
+    if (!ok) {
+        return;
+    }
+    if (!selectLogRowAt(time)) {
+        ui->statusbar->showMessage(
+                tr("The frame at %1 s is filtered out").arg(time));
+    }
+    ui->plotWidget->setCursorTime(time);
+}
+
+void MainWindow::onLogCurrentChanged(const QModelIndex &current)
+{
+    if (followingCursor || !current.isValid()) {
+        return;
+    }
+    auto index = proxyModel.mapToSource(current);
+    if (index.parent().isValid()) {
+        index = index.parent();
+    }
+    ui->plotWidget->setCursorTime(log.time(index.row()));
+}
+
 void MainWindow::onRemoveSignal(QModelIndex index)
 {
+    if (index.isValid()) {
+        ui->plotWidget->removeLane(index.row());
+    }
     plotModel.removeItem(index);
 }
 
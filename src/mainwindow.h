@@ -6,6 +6,7 @@
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QThreadPool>
+#include <QTimer>
 #include <QSortFilterProxyModel>
 #include <QStyledItemDelegate>
 #include "canlogmodel.h"
@@ -14,6 +15,8 @@
 #include "colorlisteditor.h"
 #include "signalplotlistmodel.h"
 #include "cansignalmodel.h"
+#include "signalcache.h"
+#include "tracestatsmodel.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -100,6 +103,8 @@ public slots:
     void onMsgSelect(QModelIndex index);
     void onLoadLogFile();
     void onLoadDbcFile();
+    void onStatsReady();
+    void onAddBusLoad();
     void onAddSignal(QModelIndex index);
     void onRemoveSignal(QModelIndex index);
     void onPointNotify(QString label);
@@ -112,6 +117,16 @@ public slots:
     void onZoomOutX();
     void onZoomOutY();
     void onResetAllAxis();
+    void onPlotCursor(double time);
+    void onLogCurrentChanged(const QModelIndex &current);
+    void onFilterEdited();
+    void onAddHighlightRule();
+    void onSearch();
+    void onSearchNext();
+    void onSearchPrev();
+    void onGoToTime();
+    void onSetMemoryLimit();
+    void onCompressFrames(bool enabled);
 
 private:
     static constexpr int minChartSizeStep = 5;
@@ -120,10 +135,17 @@ private:
     static constexpr int defaultYTick = 5;
     static constexpr double defaultTickPerSec = 0.1;
     static constexpr int defaultWidthPerSec = 10;
+    static constexpr int cursorSyncInterval = 16;
+    static constexpr int goToTimeDecimals = 6;
+    static constexpr qsizetype bytesPerMiB = 1024 * 1024;
+    static constexpr int minMemoryLimit = 64;
+    static constexpr int maxMemoryLimit = 1024 * 1024;
+    static constexpr auto memoryLimitKey = "memoryLimitMiB";
+    static constexpr auto compressFramesKey = "compressFrames";
 
     std::unique_ptr<Ui::MainWindow> ui;
     CanDb msgDb;
-    QVector<CanLogMsg> log;
+    FrameStore log;
     CanLogModel model;
     CustomProxyModel proxyModel;
     CanMsgModel msgModel;
@@ -131,15 +153,26 @@ private:
     CanSignalModel signalModel;
     ColorPickDelegate colorDelegate;
     LogDelegate logDelegate;
-    QFuture<QList<CanLogMsg>> logFuture;
+    QFuture<FrameStore> logFuture;
     QFuture<CanDb> dbcFuture;
-    QFutureWatcher<QList<CanLogMsg>> logWatcher;
+    QFutureWatcher<FrameStore> logWatcher;
     QFutureWatcher<CanDb> dbcWatcher;
-    double time{ 0 };
+    SignalCache signalCache;
+    TraceStatsModel statsModel;
+    QSortFilterProxyModel statsProxy;
+    QFutureWatcher<QVector<MessageStats>> statsWatcher;
+    QTimer cursorTimer;
+    double cursorTime{ 0 };
+    bool followingCursor{ false };
     int minChartSize{ defaultMinChartSize };
     int yTick{ defaultYTick };
     double tickPerSec{ defaultTickPerSec };
     int widthPerSec{ defaultWidthPerSec };
+    // Ascending rows of the frames found by the payload search
+    QVector<uint32_t> searchHits{};
     void updateChartAxis();
+    /* Selects the frame nearest to time, false when it is filtered out */
+    bool selectLogRowAt(double time);
+    void jumpToHit(bool forward);
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,198 @@
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include <QtAlgorithms>
+#include <QtConcurrent>
+#include <QtEndian>
+#include "cpufeatures.h"
+#include "payloadsearch.h"
+
+constexpr int nibbleBits = 4;
+
+/* Kernels write the indexes of the payloads whose masked word equals value
+ * to hits and return how many there are */
+using Kernel = qsizetype (*)(const CanData *payloads, qsizetype count,
+                             quint64 mask, quint64 value, uint32_t *hits);
+
+/* Scalar scan of payloads first to count, also the tail of the vector
+ * kernels */
+static qsizetype scan(const CanData *payloads, qsizetype first,
+                      qsizetype count, quint64 mask, quint64 value,
+                      uint32_t *hits, qsizetype found)
+{
+    for (auto i = first; i < count; i++) {
+        auto word = qFromLittleEndian<quint64>(payloads[i].data());
+        hits[found] = static_cast<uint32_t>(i);
+        found += ((word & mask) == value) ? 1 : 0;
+    }
+    return found;
+}
+
+static qsizetype findScalar(const CanData *payloads, qsizetype count,
+                            quint64 mask, quint64 value, uint32_t *hits)
+{
+    return scan(payloads, 0, count, mask, value, hits, 0);
+}
+
+#ifdef CPU_X86
+/* Appends the lanes set in bits, lane 0 being payload first */
+static qsizetype appendLanes(unsigned bits, qsizetype first, uint32_t *hits,
+                             qsizetype found)
+{
+    while (bits != 0) {
+        hits[found++] =
+                static_cast<uint32_t>(first + qCountTrailingZeroBits(bits));
+        bits &= bits - 1;
+    }
+    return found;
+}
+
+CPU_TARGET("avx2")
+static qsizetype findAvx2(const CanData *payloads, qsizetype count,
+                          quint64 mask, quint64 value, uint32_t *hits)
+{
+    const auto vmask = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const auto vvalue = _mm256_set1_epi64x(static_cast<long long>(value));
+    qsizetype found = 0;
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto words = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(payloads + i));
+        auto equal = _mm256_cmpeq_epi64(_mm256_and_si256(words, vmask),
+                                        vvalue);
+        auto bits = static_cast<unsigned>(
+                _mm256_movemask_pd(_mm256_castsi256_pd(equal)));
+        if (bits != 0) {
+            found = appendLanes(bits, i, hits, found);
+        }
+    }
+    return scan(payloads, i, count, mask, value, hits, found);
+}
+
+CPU_TARGET("sse4.2")
+static qsizetype findSse42(const CanData *payloads, qsizetype count,
+                           quint64 mask, quint64 value, uint32_t *hits)
+{
+    const auto vmask = _mm_set1_epi64x(static_cast<long long>(mask));
+    const auto vvalue = _mm_set1_epi64x(static_cast<long long>(value));
+    qsizetype found = 0;
+    qsizetype i = 0;
+    for (; i + 2 <= count; i += 2) {
+        auto words = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(payloads + i));
+        auto equal = _mm_cmpeq_epi64(_mm_and_si128(words, vmask), vvalue);
+        auto bits = static_cast<unsigned>(
+                _mm_movemask_pd(_mm_castsi128_pd(equal)));
+        if (bits != 0) {
+            found = appendLanes(bits, i, hits, found);
+        }
+    }
+    return scan(payloads, i, count, mask, value, hits, found);
+}
+#endif
+
+static Kernel selectKernel()
+{
+#ifdef CPU_X86
+    const auto &cpu = CpuFeatures::get();
+    if (cpu.avx2) {
+        return findAvx2;
+    }
+    if (cpu.sse42) {
+        return findSse42;
+    }
+#endif
+    return findScalar;
+}
+
+static int hexValue(QChar c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c.unicode() - '0';
+    }
+    auto lower = c.toLower();
+    if ((lower >= 'a') && (lower <= 'f')) {
+        return lower.unicode() - 'a' + 10;
+    }
+    return -1;
+}
+
+PayloadSearch PayloadSearch::compile(const QString &pattern)
+{
+    PayloadSearch search{};
+    QString digits = pattern;
+    digits.remove(' ');
+    if (digits.isEmpty()) {
+        throw std::runtime_error("Empty payload pattern");
+    }
+    if (((digits.size() % 2) != 0) || (digits.size() > 2 * CAN_MAX_DLC)) {
+        throw std::runtime_error(
+                "Payload pattern needs two digits per byte, at most 8 bytes");
+    }
+    for (qsizetype i = 0; i < digits.size(); i++) {
+        // High nibble first within a byte
+        auto shift = (i / 2) * 8 + ((i % 2) == 0 ? nibbleBits : 0);
+        auto c = digits.at(i);
+        if (c == '?') {
+            continue;
+        }
+        auto nibble = hexValue(c);
+        if (nibble < 0) {
+            throw std::runtime_error(
+                    QString("Invalid character '%1' in payload pattern")
+                            .arg(c)
+                            .toStdString());
+        }
+        search.value |= static_cast<quint64>(nibble) << shift;
+        search.mask |= quint64(0xF) << shift;
+    }
+    search.length = static_cast<uint8_t>(digits.size() / 2);
+    return search;
+}
+
+bool PayloadSearch::matches(const CanData &data, uint8_t dlc) const
+{
+    return (dlc >= length)
+            && ((qFromLittleEndian<quint64>(data.data()) & mask) == value);
+}
+
+QVector<uint32_t> PayloadSearch::find(const FrameStore &frames) const
+{
+    QVector<uint32_t> hits{};
+    if (hasId) {
+        auto rows = hasChannel ? frames.rows(channelFilter, idFilter)
+                               : frames.rowsOfId(idFilter);
+        for (auto row : rows) {
+            auto block = frames.block(FrameStore::blockOf(row));
+            auto i = row - FrameStore::blockStart(FrameStore::blockOf(row));
+            if (matches(block->data.at(i), block->dlc.at(i))) {
+                hits.append(row);
+            }
+        }
+        return hits;
+    }
+
+    static const Kernel kernel = selectKernel();
+    std::vector<QVector<uint32_t>> parts(frames.blockCount());
+    QVector<qsizetype> blocks(frames.blockCount());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    QtConcurrent::blockingMap(blocks, [&](qsizetype b) {
+        auto block = frames.block(b);
+        QVector<uint32_t> candidates(block->size());
+        auto found = kernel(block->data.constData(), block->size(), mask, value,
+                            candidates.data());
+        auto first = static_cast<uint32_t>(FrameStore::blockStart(b));
+        auto &part = parts[b];
+        for (qsizetype h = 0; h < found; h++) {
+            auto i = candidates.at(h);
+            if ((block->dlc.at(i) >= length)
+                && (!hasChannel || (block->channel.at(i) == channelFilter))) {
+                part.append(first + i);
+            }
+        }
+    });
+    for (const auto &part : parts) {
+        hits.append(part);
+    }
+    return hits;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include "canmsg.h"
+#include "framestore.h"
+
+/* Search of a byte pattern in the frame payloads. The pattern gives one
+ * byte per pair of hex digits from byte 0 on, '?' matches any nibble:
+ * "12 ?? 3? FF". Frames shorter than the pattern never match. */
+class PayloadSearch
+{
+public:
+    /* Throws std::runtime_error on a malformed pattern */
+    static PayloadSearch compile(const QString &pattern);
+
+    void setId(uint32_t id)
+    {
+        hasId = true;
+        idFilter = id;
+    }
+    void setChannel(uint8_t channel)
+    {
+        hasChannel = true;
+        channelFilter = channel;
+    }
+
+    bool matches(const CanData &data, uint8_t dlc) const;
+    /* Ascending rows of every matching frame. With an ID only its frames
+     * are tested, otherwise the payload column is scanned block by block on
+     * the thread pool with AVX2 or SSE4.2 when the CPU has them. */
+    QVector<uint32_t> find(const FrameStore &frames) const;
+
+private:
+    // Pattern bytes as a little endian word, byte i at bits 8i
+    quint64 value{ 0 };
+    quint64 mask{ 0 };
+    uint8_t length{ 0 };
+    bool hasId{ false };
+    uint32_t idFilter{ 0 };
+    bool hasChannel{ false };
+    uint8_t channelFilter{ 0 };
+};
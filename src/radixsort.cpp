@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QVector>
+#include "radixsort.h"
+
+constexpr int digitBits = 8;
+constexpr int buckets = 1 << digitBits;
+constexpr qsizetype minChunkSize = 1 << 16;
+
+void RadixSort::sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &rows)
+{
+    auto count = static_cast<qsizetype>(keys.size());
+    if (count < 2) {
+        return;
+    }
+    auto maxChunks = std::max(QThreadPool::globalInstance()->maxThreadCount(), 1)
+            * 4;
+    auto chunkCount =
+            std::clamp<qsizetype>(count / minChunkSize, 1, maxChunks);
+    auto chunkSize = (count + chunkCount - 1) / chunkCount;
+    chunkCount = (count + chunkSize - 1) / chunkSize;
+    QVector<qsizetype> chunks(chunkCount);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    auto forChunks = [&](auto &&body) {
+        QtConcurrent::blockingMap(chunks, [&](qsizetype c) {
+            body(c, c * chunkSize, std::min(count, (c + 1) * chunkSize));
+        });
+    };
+
+    // Bits that differ from the first key somewhere
+    std::vector<uint64_t> chunkVarying(chunkCount);
+    forChunks([&](qsizetype c, qsizetype first, qsizetype last) {
+        uint64_t varying = 0;
+        for (auto i = first; i < last; i++) {
+            varying |= keys[i] ^ keys[0];
+        }
+        chunkVarying[c] = varying;
+    });
+    uint64_t varying = 0;
+    for (auto bits : chunkVarying) {
+        varying |= bits;
+    }
+
+    std::vector<uint64_t> keyBuffer(count);
+    std::vector<uint32_t> rowBuffer(count);
+    std::vector<std::array<qsizetype, buckets>> offsets(chunkCount);
+    for (int shift = 0; shift < 64; shift += digitBits) {
+        if (((varying >> shift) & (buckets - 1)) == 0) {
+            continue;
+        }
+        forChunks([&](qsizetype c, qsizetype first, qsizetype last) {
+            auto &histogram = offsets[c];
+            histogram.fill(0);
+            for (auto i = first; i < last; i++) {
+                histogram[(keys[i] >> shift) & (buckets - 1)]++;
+            }
+        });
+        qsizetype offset = 0;
+        for (int digit = 0; digit < buckets; digit++) {
+            for (auto &histogram : offsets) {
+                auto size = histogram[digit];
+                histogram[digit] = offset;
+                offset += size;
+            }
+        }
+        forChunks([&](qsizetype c, qsizetype first, qsizetype last) {
+            auto &next = offsets[c];
+            for (auto i = first; i < last; i++) {
+                auto pos = next[(keys[i] >> shift) & (buckets - 1)]++;
+                keyBuffer[pos] = keys[i];
+                rowBuffer[pos] = rows[i];
+            }
+        });
+        keys.swap(keyBuffer);
+        rows.swap(rowBuffer);
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Stable LSD radix sort of 64-bit keys carrying a row each. Every pass
+ * counts digits per chunk on the thread pool, then scatters the chunks in
+ * parallel to offsets ordered by digit then chunk, which keeps equal keys
+ * in their input order. Digits equal in every key are skipped, so small
+ * keys cost as few passes as they have bytes. */
+class RadixSort
+{
+public:
+    static void sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &rows);
+};
@@ -0,0 +1,106 @@
+#include <QMutexLocker>
+#include "signalcache.h"
+
+SignalCache::SignalCache(qsizetype budget) : cache(budget)
+{
+    // Pre-decoding must not slow down the interface or a file load
+    pool.setMaxThreadCount(1);
+    pool.setThreadPriority(QThread::LowestPriority);
+}
+
+SignalCache::~SignalCache()
+{
+    generation++;
+    pool.waitForDone();
+}
+
+void SignalCache::setBudget(qsizetype bytes)
+{
+    QMutexLocker locker(&mutex);
+    cache.setMaxCost(bytes);
+}
+
+void SignalCache::reset(const FrameStore &log, const CanDb &candb)
+{
+    auto current = ++generation;
+    {
+        QMutexLocker locker(&mutex);
+        cache.clear();
+        frames = log;
+        db = candb;
+    }
+    if (!log.isEmpty() && (candb.messageCount() != 0)) {
+        pool.start([this, current]() { preDecode(current); });
+    }
+}
+
+bool SignalCache::insert(const Key &key, const SignalGraph &graph,
+                         uint64_t current, bool evict)
+{
+    QMutexLocker locker(&mutex);
+    if (current != generation) {
+        return false;
+    }
+    auto size = cost(graph);
+    if (!evict && (cache.totalCost() + size > cache.maxCost())) {
+        return false;
+    }
+    cache.insert(key, new SignalGraph(graph), size);
+    return true;
+}
+
+SignalGraph SignalCache::graph(const CanSignal &signal, uint32_t id)
+{
+    Key key{ id, signal.name };
+    uint64_t current = 0;
+    FrameStore log{};
+    {
+        QMutexLocker locker(&mutex);
+        current = generation;
+        const auto *cached = cache.object(key);
+        if (cached != nullptr) {
+            return *cached;
+        }
+        log = frames;
+    }
+    auto graph = CanSignal::getSignalGraph(signal, id, log);
+    insert(key, graph, current, true);
+    return graph;
+}
+
+void SignalCache::preDecode(uint64_t current)
+{
+    FrameStore log{};
+    CanDb candb{};
+    {
+        QMutexLocker locker(&mutex);
+        if (current != generation) {
+            return;
+        }
+        log = frames;
+        candb = db;
+    }
+    for (qsizetype m = 0; m < candb.messageCount(); m++) {
+        const auto &msg = candb.at(m);
+        if (log.rowsOfId(msg.id).isEmpty()) {
+            continue;
+        }
+        for (const auto &signal : msg.canSignals) {
+            if (current != generation) {
+                return;
+            }
+            Key key{ msg.id, signal.name };
+            {
+                QMutexLocker locker(&mutex);
+                if (cache.contains(key)) {
+                    continue;
+                }
+            }
+            // Stop once the budget is used, plotted columns are not evicted
+            auto graph = CanSignal::getSignalGraph(signal, msg.id, log);
+            if (!insert(key, graph, current, false)) {
+                return;
+            }
+        }
+    }
+}
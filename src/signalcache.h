@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <QCache>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QThreadPool>
+#include "canmsg.h"
+#include "framestore.h"
+
+/* Decoded (time, value) columns of the loaded log, keyed by message id and
+ * signal name. Columns are evicted least recently used first once their
+ * size goes over the budget. */
+class SignalCache
+{
+public:
+    static constexpr qsizetype defaultBudget = qsizetype(256) * 1024 * 1024;
+
+    explicit SignalCache(qsizetype budget = defaultBudget);
+    ~SignalCache();
+
+    void setBudget(qsizetype bytes);
+    /* Drops every column and keeps a copy of the log and database to decode
+     * from. When both are loaded the signals seen in the log are decoded in
+     * the background. */
+    void reset(const FrameStore &log, const CanDb &db);
+    SignalGraph graph(const CanSignal &signal, uint32_t id);
+
+private:
+    using Key = QPair<uint32_t, QString>;
+
+    static qsizetype cost(const SignalGraph &graph)
+    {
+        return graph.size() * qsizetype(sizeof(SignalGraph::value_type));
+    }
+    bool insert(const Key &key, const SignalGraph &graph, uint64_t generation,
+                bool evict);
+    void preDecode(uint64_t generation);
+
+    QMutex mutex;
+    QCache<Key, SignalGraph> cache;
+    FrameStore frames{};
+    CanDb db{};
+    std::atomic<uint64_t> generation{ 0 };
+    QThreadPool pool;
+};
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <QtEndian>
+#include "cpufeatures.h"
+#include "signaldecoder.h"
+
+static_assert(sizeof(CanData) == sizeof(quint64),
+              "Payloads are loaded as one 64 bit word");
+
+constexpr uint8_t bitsInByte = 8;
+/* Raw values of at most 48 bits, signed or not, are converted to double in
+ * the vector registers by adding them to the mantissa of 1.5 * 2^52 */
+constexpr uint8_t maxVectorLen = 48;
+constexpr long long doubleBias = 0x4338000000000000;
+constexpr double doubleBiasValue = 6755399441055744.0;
+
+/* Kernels decode a prefix of the frames and return its length, the rest is
+ * left to the scalar path */
+using Kernel = qsizetype (*)(const CanSignal::Plan &plan,
+                             const CanData *payloads, const uint32_t *rows,
+                             qsizetype count, double scale, double offset,
+                             double *out);
+
+static qsizetype decodeScalar(const CanSignal::Plan &, const CanData *,
+                              const uint32_t *, qsizetype, double, double,
+                              double *)
+{
+    return 0;
+}
+
+#ifdef CPU_X86
+static uint64_t lowBitsMask(const CanSignal::Plan &plan)
+{
+    return (plan.lowBits == 0) ? 0 : ((uint64_t(1) << plan.lowBits) - 1);
+}
+
+CPU_TARGET("avx2")
+static qsizetype decodeAvx2(const CanSignal::Plan &plan,
+                            const CanData *payloads, const uint32_t *rows,
+                            qsizetype count, double scale, double offset,
+                            double *out)
+{
+    const auto shift = _mm_cvtsi32_si128(plan.startBit);
+    const auto swapShift = _mm_cvtsi32_si128(plan.swapShift);
+    const auto lowBits = _mm_cvtsi32_si128(plan.lowBits);
+    const auto firstShift = _mm_cvtsi32_si128(plan.firstShift);
+    const auto signShift = _mm_cvtsi32_si128(plan.len - 1);
+    const auto mask = _mm256_set1_epi64x(static_cast<long long>(plan.mask));
+    const auto fieldMask =
+            _mm256_set1_epi64x(static_cast<long long>(plan.fieldMask));
+    const auto lowMask =
+            _mm256_set1_epi64x(static_cast<long long>(lowBitsMask(plan)));
+    const auto range =
+            _mm256_set1_epi64x(static_cast<long long>(plan.mask + 1));
+    const auto swap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12,
+                                       11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                       15, 14, 13, 12, 11, 10, 9, 8);
+    const auto zero = _mm256_setzero_si256();
+    const auto bias = _mm256_set1_epi64x(doubleBias);
+    const auto biasValue = _mm256_set1_pd(doubleBiasValue);
+    const auto vscale = _mm256_set1_pd(scale);
+    const auto voffset = _mm256_set1_pd(offset);
+    const auto *base = reinterpret_cast<const long long *>(payloads);
+
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i raw;
+        if (rows != nullptr) {
+            auto index = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(rows + i));
+            raw = _mm256_i32gather_epi64(base, index, sizeof(CanData));
+        } else {
+            raw = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(payloads + i));
+        }
+        if (plan.isBigEndian) {
+            raw = _mm256_srl_epi64(
+                    _mm256_shuffle_epi8(_mm256_and_si256(raw, fieldMask),
+                                        swap),
+                    swapShift);
+            raw = _mm256_or_si256(
+                    _mm256_and_si256(raw, lowMask),
+                    _mm256_sll_epi64(_mm256_srl_epi64(raw, firstShift),
+                                     lowBits));
+        } else {
+            raw = _mm256_and_si256(_mm256_srl_epi64(raw, shift), mask);
+        }
+        if (plan.isSigned) {
+            auto positive = _mm256_cmpeq_epi64(
+                    _mm256_srl_epi64(raw, signShift), zero);
+            raw = _mm256_sub_epi64(raw, _mm256_andnot_si256(positive, range));
+        }
+        auto value = _mm256_sub_pd(
+                _mm256_castsi256_pd(_mm256_add_epi64(raw, bias)), biasValue);
+        _mm256_storeu_pd(out + i,
+                         _mm256_add_pd(_mm256_mul_pd(value, vscale), voffset));
+    }
+    return i;
+}
+
+CPU_TARGET("sse4.2")
+static qsizetype decodeSse42(const CanSignal::Plan &plan,
+                             const CanData *payloads, const uint32_t *rows,
+                             qsizetype count, double scale, double offset,
+                             double *out)
+{
+    const auto shift = _mm_cvtsi32_si128(plan.startBit);
+    const auto swapShift = _mm_cvtsi32_si128(plan.swapShift);
+    const auto lowBits = _mm_cvtsi32_si128(plan.lowBits);
+    const auto firstShift = _mm_cvtsi32_si128(plan.firstShift);
+    const auto signShift = _mm_cvtsi32_si128(plan.len - 1);
+    const auto mask = _mm_set1_epi64x(static_cast<long long>(plan.mask));
+    const auto fieldMask =
+            _mm_set1_epi64x(static_cast<long long>(plan.fieldMask));
+    const auto lowMask =
+            _mm_set1_epi64x(static_cast<long long>(lowBitsMask(plan)));
+    const auto range = _mm_set1_epi64x(static_cast<long long>(plan.mask + 1));
+    const auto swap = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11,
+                                    10, 9, 8);
+    const auto zero = _mm_setzero_si128();
+    const auto bias = _mm_set1_epi64x(doubleBias);
+    const auto biasValue = _mm_set1_pd(doubleBiasValue);
+    const auto vscale = _mm_set1_pd(scale);
+    const auto voffset = _mm_set1_pd(offset);
+
+    qsizetype i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i raw;
+        if (rows != nullptr) {
+            raw = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i *>(
+                            payloads + rows[i])),
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i *>(
+                            payloads + rows[i + 1])));
+        } else {
+            raw = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(payloads + i));
+        }
+        if (plan.isBigEndian) {
+            raw = _mm_srl_epi64(
+                    _mm_shuffle_epi8(_mm_and_si128(raw, fieldMask), swap),
+                    swapShift);
+            raw = _mm_or_si128(
+                    _mm_and_si128(raw, lowMask),
+                    _mm_sll_epi64(_mm_srl_epi64(raw, firstShift), lowBits));
+        } else {
+            raw = _mm_and_si128(_mm_srl_epi64(raw, shift), mask);
+        }
+        if (plan.isSigned) {
+            auto positive =
+                    _mm_cmpeq_epi64(_mm_srl_epi64(raw, signShift), zero);
+            raw = _mm_sub_epi64(raw, _mm_andnot_si128(positive, range));
+        }
+        auto value = _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(raw, bias)),
+                                biasValue);
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(value, vscale), voffset));
+    }
+    return i;
+}
+#endif
+
+bool SignalDecoder::supported(Isa isa)
+{
+#ifdef CPU_X86
+    const auto &cpu = CpuFeatures::get();
+    switch (isa) {
+    case Isa::Avx2:
+        return cpu.avx2;
+    case Isa::Sse42:
+        return cpu.sse42;
+    default:
+        break;
+    }
+#endif
+    return isa == Isa::Scalar;
+}
+
+static Kernel kernelOf(SignalDecoder::Isa isa)
+{
+#ifdef CPU_X86
+    switch (isa) {
+    case SignalDecoder::Isa::Avx2:
+        return decodeAvx2;
+    case SignalDecoder::Isa::Sse42:
+        return decodeSse42;
+    default:
+        break;
+    }
+#endif
+    return decodeScalar;
+}
+
+static SignalDecoder::Isa selectIsa()
+{
+    for (auto isa : { SignalDecoder::Isa::Avx2, SignalDecoder::Isa::Sse42 }) {
+        if (SignalDecoder::supported(isa)) {
+            return isa;
+        }
+    }
+    return SignalDecoder::Isa::Scalar;
+}
+
+void SignalDecoder::decode(const CanSignal &signal, const CanData *payloads,
+                           const uint8_t *dlc, const uint32_t *rows,
+                           qsizetype count, double *out)
+{
+    static const Isa best = selectIsa();
+    decode(best, signal, payloads, dlc, rows, count, out);
+}
+
+void SignalDecoder::decode(Isa isa, const CanSignal &signal,
+                           const CanData *payloads, const uint8_t *dlc,
+                           const uint32_t *rows, qsizetype count, double *out)
+{
+    const auto plan = signal.plan.matches(signal)
+            ? signal.plan
+            : CanSignal::compilePlan(signal);
+    if (plan.kind == CanSignal::Plan::Invalid) {
+        std::fill(out, out + count, qQNaN());
+        return;
+    }
+    auto frame = [rows](qsizetype i) {
+        return (rows != nullptr) ? rows[i] : i;
+    };
+
+    qsizetype done = 0;
+    if (plan.rawBits <= maxVectorLen) {
+        done = kernelOf(isa)(plan, payloads, rows, count, signal.scale,
+                             signal.offset, out);
+        // The kernels do not look at the frame length
+        for (qsizetype i = 0; i < done; i++) {
+            if (plan.endBit > dlc[frame(i)] * bitsInByte) {
+                out[i] = qQNaN();
+            }
+        }
+    }
+    for (auto i = done; i < count; i++) {
+        auto f = frame(i);
+        out[i] = (CanSignal::parseRaw(plan, payloads[f], dlc[f]) * signal.scale)
+                + signal.offset;
+    }
+}
+
+QVector<double> SignalDecoder::decode(const CanSignal &signal,
+                                      const QVector<CanData> &payloads,
+                                      const QVector<uint8_t> &dlc)
+{
+    QVector<double> values(payloads.size());
+    decode(signal, payloads.constData(), dlc.constData(), nullptr,
+           payloads.size(), values.data());
+    return values;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "canmsg.h"
+
+/* Decodes one signal over many frames at once. The raw value extraction
+ * runs on AVX2 or SSE4.2 when the CPU has them, with a scalar fallback. */
+class SignalDecoder
+{
+public:
+    // Instruction sets of the extraction kernels
+    enum class Isa { Scalar, Sse42, Avx2 };
+
+    static bool supported(Isa isa);
+
+    /* Writes the physical value of signal for count payloads to out. With
+     * rows set, frame i is payloads[rows[i]], otherwise payloads[i]. Frames
+     * too short for the signal give NaN, as parseSignal() does. */
+    static void decode(const CanSignal &signal, const CanData *payloads,
+                       const uint8_t *dlc, const uint32_t *rows,
+                       qsizetype count, double *out);
+    /* Same on the kernel of isa, which must be supported, for checking the
+     * kernels against each other */
+    static void decode(Isa isa, const CanSignal &signal,
+                       const CanData *payloads, const uint8_t *dlc,
+                       const uint32_t *rows, qsizetype count, double *out);
+
+    static QVector<double> decode(const CanSignal &signal,
+                                  const QVector<CanData> &payloads,
+                                  const QVector<uint8_t> &dlc);
+};
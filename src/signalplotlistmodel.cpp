@@ -12,6 +12,9 @@ QVariant SignalPlotListModel::data(const QModelIndex &index, int role) const
 
     if (role == Qt::DisplayRole) {
         auto item = items.at(index.row());
+        if (item.msgId == noCanId) {
+            return item.signal.name;
+        }
         return QString("%2 - %1")
                 .arg(CanMessage::formatId(item.msgId))
                 .arg(item.signal.name);
@@ -19,14 +22,12 @@ QVariant SignalPlotListModel::data(const QModelIndex &index, int role) const
         return {};
 }
 
-void SignalPlotListModel::addItem(uint32_t msgId, const CanSignal &signal,
-                                  CustomQChartView *widget)
+void SignalPlotListModel::addItem(uint32_t msgId, const CanSignal &signal)
 {
     SignalPlotItem const item(msgId, signal);
     auto index = QAbstractItemModel::createIndex(items.size(), 0);
     beginInsertRows(index, items.size(), items.size());
     items.append(item);
-    widgets.append(widget);
     endInsertRows();
 }
 
@@ -35,9 +36,6 @@ void SignalPlotListModel::removeItem(const QModelIndex &index)
     if (index.isValid()) {
         beginRemoveRows(index, index.row(), index.row());
         items.remove(index.row());
-        auto widget = widgets.at(index.row());
-        delete widget;
-        widgets.remove(index.row());
         endRemoveRows();
     }
 }
@@ -46,9 +44,5 @@ void SignalPlotListModel::reset()
 {
     beginResetModel();
     items.clear();
-    for (auto w : widgets) {
-        delete w;
-    }
-    widgets.clear();
     endResetModel();
 }
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPolygonF>
+#include <QScrollBar>
+#include "signalplotwidget.h"
+
+constexpr int minTickSpacing = 40;
+constexpr int laneHueStep = 47;
+
+SignalPlotWidget::SignalPlotWidget(QWidget *parent)
+    : QAbstractScrollArea(parent)
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    viewport()->setMouseTracking(true);
+    viewport()->setBackgroundRole(QPalette::Base);
+    viewport()->setAutoFillBackground(true);
+}
+
+void SignalPlotWidget::addLane(uint32_t msgId, const CanSignal &signal,
+                               const SignalGraph &graph)
+{
+    Lane lane{ msgId, signal, SignalPyramid(graph), 0, 0 };
+    if (!lane.pyramid.isEmpty()) {
+        lane.minValue = lane.pyramid.minValue();
+        lane.maxValue = lane.pyramid.maxValue();
+    }
+    if (std::isnan(lane.minValue)) {
+        lane.minValue = 0;
+        lane.maxValue = 0;
+    }
+    if (lane.minValue == lane.maxValue) {
+        // Flat signal, keep the line off the lane borders
+        lane.minValue -= 1;
+        lane.maxValue += 1;
+    }
+    lanes.append(lane);
+    updateTimeRange();
+}
+
+void SignalPlotWidget::removeLane(int index)
+{
+    if ((index < 0) || (index >= lanes.size())) {
+        return;
+    }
+    lanes.removeAt(index);
+    updateTimeRange();
+}
+
+void SignalPlotWidget::clear()
+{
+    lanes.clear();
+    updateTimeRange();
+}
+
+void SignalPlotWidget::setPixelsPerSecond(double pixels)
+{
+    // Keep the left border of the view on the same time
+    auto start = viewStart();
+    pixelsPerSecond = pixels;
+    updateScrollBars();
+    horizontalScrollBar()->setValue(
+            static_cast<int>((start - timeStart) * pixelsPerSecond));
+    viewport()->update();
+}
+
+void SignalPlotWidget::setLaneHeight(int height)
+{
+    laneHeight = height;
+    updateScrollBars();
+    viewport()->update();
+}
+
+void SignalPlotWidget::setXTicksPerSecond(double ticks)
+{
+    xTicksPerSecond = ticks;
+    viewport()->update();
+}
+
+void SignalPlotWidget::setYTicks(int ticks)
+{
+    yTicks = ticks;
+    viewport()->update();
+}
+
+void SignalPlotWidget::setCursorTime(double time)
+{
+    cursor = time;
+    viewport()->update();
+}
+
+void SignalPlotWidget::updateTimeRange()
+{
+    timeStart = 0;
+    timeEnd = 0;
+    auto first = true;
+    for (const auto &lane : lanes) {
+        if (lane.pyramid.isEmpty()) {
+            continue;
+        }
+        if (first) {
+            timeStart = lane.pyramid.firstTime();
+            timeEnd = lane.pyramid.lastTime();
+            first = false;
+        } else {
+            timeStart = std::min(timeStart, lane.pyramid.firstTime());
+            timeEnd = std::max(timeEnd, lane.pyramid.lastTime());
+        }
+    }
+    updateScrollBars();
+    viewport()->update();
+}
+
+void SignalPlotWidget::updateScrollBars()
+{
+    auto plotWidth = std::max(0, viewport()->width() - axisWidth);
+    auto totalWidth = std::min<double>(
+            std::ceil((timeEnd - timeStart) * pixelsPerSecond), INT_MAX);
+    horizontalScrollBar()->setRange(
+            0, std::max(0, static_cast<int>(totalWidth) - plotWidth));
+    horizontalScrollBar()->setPageStep(plotWidth);
+    horizontalScrollBar()->setSingleStep(std::max(1, plotWidth / 10));
+
+    auto laneArea = std::max(0, viewport()->height() - rulerHeight);
+    verticalScrollBar()->setRange(
+            0, std::max(0, (laneCount() * laneHeight) - laneArea));
+    verticalScrollBar()->setPageStep(laneArea);
+    verticalScrollBar()->setSingleStep(std::max(1, laneHeight / 4));
+}
+
+double SignalPlotWidget::viewStart() const
+{
+    return timeStart + (horizontalScrollBar()->value() / pixelsPerSecond);
+}
+
+double SignalPlotWidget::timeAt(int x) const
+{
+    return viewStart() + ((x - axisWidth) / pixelsPerSecond);
+}
+
+int SignalPlotWidget::xAt(double time) const
+{
+    return axisWidth
+            + static_cast<int>(std::lround((time - viewStart())
+                                           * pixelsPerSecond));
+}
+
+QRect SignalPlotWidget::laneRect(int index) const
+{
+    return { 0, (index * laneHeight) - verticalScrollBar()->value(),
+             viewport()->width(), laneHeight };
+}
+
+void SignalPlotWidget::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void SignalPlotWidget::scrollContentsBy(int, int)
+{
+    viewport()->update();
+}
+
+void SignalPlotWidget::paintEvent(QPaintEvent *)
+{
+    QPainter painter(viewport());
+    auto laneArea = viewport()->height() - rulerHeight;
+    painter.setClipRect(0, 0, viewport()->width(), laneArea);
+    // Only the lanes in view
+    auto first = verticalScrollBar()->value() / laneHeight;
+    for (int i = first; i < laneCount(); i++) {
+        auto rect = laneRect(i);
+        if (rect.top() >= laneArea) {
+            break;
+        }
+        paintLane(painter, i, rect);
+    }
+    painter.setClipping(false);
+    paintRuler(painter);
+    auto x = std::isnan(cursor) ? -1 : xAt(cursor);
+    if ((x >= axisWidth) && (x < viewport()->width())) {
+        painter.setPen(QPen(palette().highlight().color(), 1));
+        painter.drawLine(x, 0, x, laneArea);
+    }
+}
+
+/* Time between two vertical grid lines, the ticks per second setting
+ * widened so that labels do not overlap */
+static double tickInterval(double ticksPerSecond, double pixelsPerSecond)
+{
+    auto interval = (ticksPerSecond > 0) ? (1.0 / ticksPerSecond) : 1.0;
+    while (interval * pixelsPerSecond < minTickSpacing) {
+        interval *= 2;
+    }
+    return interval;
+}
+
+void SignalPlotWidget::paintLane(QPainter &painter, int index,
+                                 const QRect &rect)
+{
+    auto &lane = lanes[index];
+    QRect plot(rect.left() + axisWidth, rect.top() + laneMargin,
+               rect.width() - axisWidth, rect.height() - (2 * laneMargin));
+    auto range = lane.maxValue - lane.minValue;
+    auto yAt = [&](double value) {
+        return plot.bottom()
+                - ((value - lane.minValue) / range * plot.height());
+    };
+
+    painter.setPen(palette().mid().color());
+    painter.drawLine(rect.bottomLeft(), rect.bottomRight());
+    painter.drawLine(plot.left(), rect.top(), plot.left(), rect.bottom());
+
+    // Grid and value labels
+    QPen gridPen(palette().midlight().color(), 1, Qt::DotLine);
+    auto interval = tickInterval(xTicksPerSecond, pixelsPerSecond);
+    auto start = viewStart();
+    auto end = timeAt(rect.right());
+    for (auto t = std::ceil(start / interval) * interval; t <= end;
+         t += interval) {
+        painter.setPen(gridPen);
+        painter.drawLine(xAt(t), plot.top(), xAt(t), plot.bottom());
+    }
+    auto fontHeight = painter.fontMetrics().height();
+    for (int k = 0; (yTicks > 1) && (k < yTicks); k++) {
+        auto value = lane.minValue + (range * k / (yTicks - 1));
+        auto y = static_cast<int>(yAt(value));
+        painter.setPen(gridPen);
+        painter.drawLine(plot.left(), y, plot.right(), y);
+        painter.setPen(palette().text().color());
+        painter.drawText(QRect(rect.left(), y - (fontHeight / 2),
+                               axisWidth - laneMargin, fontHeight),
+                         Qt::AlignRight | Qt::AlignVCenter,
+                         QString::number(value, 'g', 6));
+    }
+
+    // Signal, at most a few points per pixel column of the window
+    QColor color = QColor::fromHsv((index * laneHueStep) % 360, 220, 180);
+    painter.save();
+    painter.setClipRect(plot.intersected(painter.clipBoundingRect().toRect()));
+    painter.setPen(QPen(color, 1));
+    if ((lane.drawnStart != start) || (lane.drawnScale != pixelsPerSecond)
+        || (lane.drawnWidth != plot.width())) {
+        lane.drawn = lane.pyramid.decimate(start, end, plot.width());
+        lane.drawnStart = start;
+        lane.drawnScale = pixelsPerSecond;
+        lane.drawnWidth = plot.width();
+    }
+    QPolygonF line{};
+    line.reserve(lane.drawn.size());
+    for (const auto &point : lane.drawn) {
+        if (std::isnan(point.y())) {
+            // Frames too short for the signal break the line
+            painter.drawPolyline(line);
+            line.clear();
+            continue;
+        }
+        line.append({ static_cast<double>(xAt(point.x())), yAt(point.y()) });
+    }
+    painter.drawPolyline(line);
+    painter.restore();
+
+    painter.setPen(color);
+    painter.drawText(plot.adjusted(laneMargin, 0, 0, 0),
+                     Qt::AlignLeft | Qt::AlignTop,
+                     (lane.msgId == noCanId)
+                             ? lane.signal.name
+                             : QString("%1 - %2")
+                                       .arg(CanMessage::formatId(lane.msgId))
+                                       .arg(lane.signal.name));
+
+    // Value held at the cursor
+    auto x = std::isnan(cursor) ? -1 : xAt(cursor);
+    if ((x < plot.left()) || (x > plot.right()) || lane.pyramid.isEmpty()) {
+        return;
+    }
+    auto value = lane.pyramid.valueAt(cursor);
+    if (!std::isnan(value)) {
+        painter.setBrush(color);
+        painter.drawEllipse(QPointF(x, yAt(value)), laneMargin / 2.0,
+                            laneMargin / 2.0);
+        painter.setBrush(Qt::NoBrush);
+    }
+    painter.drawText(QRect(x + laneMargin, plot.top(), plot.right() - x,
+                           fontHeight),
+                     Qt::AlignLeft | Qt::AlignTop,
+                     lane.signal.display(value));
+}
+
+void SignalPlotWidget::paintRuler(QPainter &painter)
+{
+    QRect ruler(axisWidth, viewport()->height() - rulerHeight,
+                viewport()->width() - axisWidth, rulerHeight);
+    painter.fillRect(ruler, palette().window());
+    painter.setPen(palette().windowText().color());
+    painter.drawLine(ruler.topLeft(), ruler.topRight());
+    if (lanes.isEmpty()) {
+        return;
+    }
+    auto interval = tickInterval(xTicksPerSecond, pixelsPerSecond);
+    auto decimals = std::max(0, -static_cast<int>(std::floor(
+                                        std::log10(interval))));
+    auto end = timeAt(ruler.right());
+    for (auto t = std::ceil(viewStart() / interval) * interval; t <= end;
+         t += interval) {
+        auto x = xAt(t);
+        painter.drawLine(x, ruler.top(), x, ruler.top() + laneMargin);
+        painter.drawText(QRect(x - minTickSpacing, ruler.top() + laneMargin,
+                               2 * minTickSpacing, rulerHeight - laneMargin),
+                         Qt::AlignHCenter | Qt::AlignTop,
+                         QString::number(t, 'f', decimals));
+    }
+}
+
+void SignalPlotWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    auto pos = event->position().toPoint();
+    if ((pos.x() < axisWidth) || lanes.isEmpty()) {
+        return;
+    }
+    cursor = timeAt(pos.x());
+    viewport()->update();
+    emit cursorMoved(cursor);
+    auto index = (pos.y() + verticalScrollBar()->value()) / laneHeight;
+    if ((index >= laneCount())
+        || (pos.y() >= viewport()->height() - rulerHeight)) {
+        return;
+    }
+    const auto &lane = lanes.at(index);
+    emit pointNotify(QString("%3: %1, %2")
+                             .arg(cursor)
+                             .arg(lane.signal.display(
+                                     lane.pyramid.valueAt(cursor)))
+                             .arg(lane.signal.name));
+}
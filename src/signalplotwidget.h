@@ -0,0 +1,77 @@
+#pragma once
+#include <QAbstractScrollArea>
+#include <QList>
+#include <QString>
+#include "canmsg.h"
+#include "signalpyramid.h"
+
+/* Plots every selected signal in its own lane over one shared time axis.
+ * Only the lanes and the time window in view are painted, each lane from
+ * the min/max pyramid of its decoded signal. */
+class SignalPlotWidget : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    SignalPlotWidget(QWidget *parent = nullptr);
+
+    void addLane(uint32_t msgId, const CanSignal &signal,
+                 const SignalGraph &graph);
+    void removeLane(int index);
+    void clear();
+    int laneCount() const { return lanes.size(); }
+
+    void setPixelsPerSecond(double pixels);
+    void setLaneHeight(int height);
+    void setXTicksPerSecond(double ticks);
+    void setYTicks(int ticks);
+    /* Moves the shared time cursor, NaN hides it */
+    void setCursorTime(double time);
+    double cursorTime() const { return cursor; }
+
+signals:
+    void pointNotify(QString label);
+    void cursorMoved(double time);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    static constexpr int axisWidth = 80;
+    static constexpr int rulerHeight = 20;
+    static constexpr int laneMargin = 4;
+
+    struct Lane
+    {
+        uint32_t msgId;
+        CanSignal signal;
+        SignalPyramid pyramid;
+        double minValue;
+        double maxValue;
+        // Points drawn for the last view, kept while only the cursor moves
+        QList<QPointF> drawn{};
+        double drawnStart{ 0 };
+        double drawnScale{ 0 };
+        int drawnWidth{ -1 };
+    };
+
+    void updateTimeRange();
+    void updateScrollBars();
+    double viewStart() const;
+    double timeAt(int x) const;
+    int xAt(double time) const;
+    QRect laneRect(int index) const;
+    void paintLane(QPainter &painter, int index, const QRect &rect);
+    void paintRuler(QPainter &painter);
+
+    QList<Lane> lanes{};
+    double timeStart{ 0 };
+    double timeEnd{ 0 };
+    double pixelsPerSecond{ 10 };
+    double xTicksPerSecond{ 0.1 };
+    int laneHeight{ 150 };
+    int yTicks{ 5 };
+    double cursor{ qQNaN() };
+};
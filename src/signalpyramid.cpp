@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "signalpyramid.h"
+
+// Frames too short for a signal decode to NaN, they never win over a value
+static bool isLower(double value, double than)
+{
+    return (value < than) || (std::isnan(than) && !std::isnan(value));
+}
+
+static bool isGreater(double value, double than)
+{
+    return (value > than) || (std::isnan(than) && !std::isnan(value));
+}
+
+SignalPyramid::SignalPyramid(const SignalGraph &graph) : graph(graph)
+{
+    auto count = graph.size();
+    while (count > 1) {
+        auto blocks = (count + fanout - 1) / fanout;
+        Level level{};
+        level.minIndex.reserve(blocks);
+        level.maxIndex.reserve(blocks);
+        for (qsizetype b = 0; b < blocks; b++) {
+            auto first = b * fanout;
+            auto last = std::min(first + fanout, count);
+            qsizetype minIndex = -1;
+            qsizetype maxIndex = -1;
+            for (auto unit = first; unit < last; unit++) {
+                qsizetype unitMin = unit;
+                qsizetype unitMax = unit;
+                if (!levels.isEmpty()) {
+                    unitMin = levels.last().minIndex.at(unit);
+                    unitMax = levels.last().maxIndex.at(unit);
+                }
+                if ((minIndex < 0)
+                    || isLower(graph.at(unitMin).second,
+                               graph.at(minIndex).second)) {
+                    minIndex = unitMin;
+                }
+                if ((maxIndex < 0)
+                    || isGreater(graph.at(unitMax).second,
+                                 graph.at(maxIndex).second)) {
+                    maxIndex = unitMax;
+                }
+            }
+            level.minIndex.append(static_cast<uint32_t>(minIndex));
+            level.maxIndex.append(static_cast<uint32_t>(maxIndex));
+        }
+        levels.append(std::move(level));
+        count = blocks;
+    }
+}
+
+double SignalPyramid::minValue() const
+{
+    if (graph.isEmpty()) {
+        return qQNaN();
+    }
+    qsizetype index = levels.isEmpty() ? 0 : levels.last().minIndex.first();
+    return graph.at(index).second;
+}
+
+double SignalPyramid::maxValue() const
+{
+    if (graph.isEmpty()) {
+        return qQNaN();
+    }
+    qsizetype index = levels.isEmpty() ? 0 : levels.last().maxIndex.first();
+    return graph.at(index).second;
+}
+
+qsizetype SignalPyramid::lowerBound(double time) const
+{
+    auto it = std::lower_bound(
+            graph.cbegin(), graph.cend(), time,
+            [](const auto &point, double t) { return point.first < t; });
+    return it - graph.cbegin();
+}
+
+double SignalPyramid::valueAt(double time) const
+{
+    if (graph.isEmpty()) {
+        return qQNaN();
+    }
+    auto it = std::upper_bound(
+            graph.cbegin(), graph.cend(), time,
+            [](double t, const auto &point) { return t < point.first; });
+    if (it != graph.cbegin()) {
+        it--;
+    }
+    return it->second;
+}
+
+void SignalPyramid::minMax(qsizetype first, qsizetype last,
+                           qsizetype &minIndex, qsizetype &maxIndex) const
+{
+    minIndex = first;
+    maxIndex = first;
+    auto take = [&](qsizetype level, qsizetype unit) {
+        qsizetype unitMin = unit;
+        qsizetype unitMax = unit;
+        if (level >= 0) {
+            unitMin = levels.at(level).minIndex.at(unit);
+            unitMax = levels.at(level).maxIndex.at(unit);
+        }
+        if (isLower(graph.at(unitMin).second, graph.at(minIndex).second)) {
+            minIndex = unitMin;
+        }
+        if (isGreater(graph.at(unitMax).second, graph.at(maxIndex).second)) {
+            maxIndex = unitMax;
+        }
+    };
+
+    /* Take the units sticking out of whole blocks at both ends, then go up
+     * one level with the blocks left in the middle */
+    qsizetype level = -1;
+    while (first < last) {
+        if (level + 1 >= levels.size()) {
+            for (; first < last; first++) {
+                take(level, first);
+            }
+            break;
+        }
+        for (; (first < last) && ((first % fanout) != 0); first++) {
+            take(level, first);
+        }
+        for (; (first < last) && ((last % fanout) != 0); last--) {
+            take(level, last - 1);
+        }
+        first /= fanout;
+        last /= fanout;
+        level++;
+    }
+}
+
+void SignalPyramid::appendPoint(QList<QPointF> &points, qsizetype index) const
+{
+    const auto &point = graph.at(index);
+    points.append({ point.first, point.second });
+}
+
+QList<QPointF> SignalPyramid::decimate(double from, double to,
+                                       int columns) const
+{
+    QList<QPointF> points{};
+    if (graph.isEmpty() || (columns <= 0) || (to < from)) {
+        return points;
+    }
+    // One more point on each side, the line must enter and leave the range
+    auto first = std::max<qsizetype>(lowerBound(from) - 1, 0);
+    auto last = std::min(lowerBound(std::nextafter(to, qInf())) + 1,
+                         graph.size());
+    if (last - first <= pointsPerColumn * columns) {
+        points.reserve(last - first);
+        for (auto i = first; i < last; i++) {
+            appendPoint(points, i);
+        }
+        return points;
+    }
+
+    points.reserve(pointsPerColumn * columns);
+    auto step = (to - from) / columns;
+    auto start = first;
+    for (int column = 1; (column <= columns) && (start < last); column++) {
+        auto end = last;
+        if (column < columns) {
+            end = std::clamp(lowerBound(from + (step * column)), start, last);
+        }
+        if (end == start) {
+            continue;
+        }
+        std::array<qsizetype, pointsPerColumn> column4{ start, 0, 0, end - 1 };
+        minMax(start, end, column4[1], column4[2]);
+        std::sort(column4.begin(), column4.end());
+        auto unique = std::unique(column4.begin(), column4.end());
+        for (auto it = column4.begin(); it != unique; it++) {
+            appendPoint(points, *it);
+        }
+        start = end;
+    }
+    return points;
+}
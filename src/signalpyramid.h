@@ -0,0 +1,46 @@
+#pragma once
+#include <QList>
+#include <QPointF>
+#include <QVector>
+#include "canmsg.h"
+
+/* Min/max pyramid over a decoded signal. A plot asks for the points of its
+ * visible range and gets at most the first, min, max and last point of each
+ * pixel column (M4), so the drawing cost follows the widget width and not
+ * the trace length while every peak stays visible. */
+class SignalPyramid
+{
+public:
+    explicit SignalPyramid(const SignalGraph &graph);
+
+    const SignalGraph &points() const { return graph; }
+    bool isEmpty() const { return graph.isEmpty(); }
+    double minValue() const;
+    double maxValue() const;
+    double firstTime() const { return graph.first().first; }
+    double lastTime() const { return graph.last().first; }
+
+    /* Value held at time: the last point at or before it */
+    double valueAt(double time) const;
+    QList<QPointF> decimate(double from, double to, int columns) const;
+
+private:
+    static constexpr qsizetype fanout = 8;
+    static constexpr qsizetype pointsPerColumn = 4;
+
+    /* Points of min and max value of every block of fanout^(level + 1)
+     * points */
+    struct Level
+    {
+        QVector<uint32_t> minIndex;
+        QVector<uint32_t> maxIndex;
+    };
+
+    qsizetype lowerBound(double time) const;
+    void minMax(qsizetype first, qsizetype last, qsizetype &minIndex,
+                qsizetype &maxIndex) const;
+    void appendPoint(QList<QPointF> &points, qsizetype index) const;
+
+    SignalGraph graph;
+    QVector<Level> levels{};
+};
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <numeric>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "blockcache.h"
+#include "logparser.h"
+#include "tracecache.h"
+
+/* File layout, native byte order:
+ *   Header
+ *   BlockEntry per block
+ *   KeyEntry per (channel, id), ascending keys
+ *   uint32 rows of all posting lists, padded to alignment
+ *   double samples of the TimeIndex
+ *   blocks in the stored form of FrameBlock
+ *   uint64 checksum per block
+ * The header checksum covers everything up to the blocks but its own
+ * field. */
+constexpr std::array<char, 8> magic{ 'C', 'A', 'N', 'T', 'R', 'A', 'C', 'E' };
+constexpr quint32 byteOrderMark = 0x01020304;
+constexpr qsizetype alignment = 8;
+constexpr quint64 fnvOffset = 14695981039346656037ULL;
+constexpr quint64 fnvPrime = 1099511628211ULL;
+
+struct Header
+{
+    std::array<char, 8> magic;
+    quint32 byteOrder;
+    quint32 version;
+    quint32 blockShift;
+    quint32 timeStrideShift;
+    quint64 sourceSize;
+    qint64 sourceTime;
+    quint64 frameCount;
+    quint64 keyCount;
+    quint64 fileSize;
+    double maxTime;
+    quint64 checksum;
+};
+
+struct BlockEntry
+{
+    quint64 offset;
+};
+
+struct KeyEntry
+{
+    quint64 key;
+    // Position and length of the posting list in the rows
+    quint64 first;
+    quint64 count;
+};
+
+static_assert(sizeof(Header) % alignment == 0);
+static_assert(offsetof(Header, checksum) + sizeof(quint64) == sizeof(Header));
+
+static qsizetype aligned(qsizetype size)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static qsizetype timeSamples(qsizetype frames)
+{
+    return (frames + TimeIndex::stride - 1) >> TimeIndex::strideShift;
+}
+
+static qsizetype directorySize(qsizetype blocks, qsizetype keys,
+                               qsizetype frames)
+{
+    return static_cast<qsizetype>(sizeof(Header))
+            + (blocks * static_cast<qsizetype>(sizeof(BlockEntry)))
+            + (keys * static_cast<qsizetype>(sizeof(KeyEntry)))
+            + aligned(frames * static_cast<qsizetype>(sizeof(uint32_t)))
+            + (timeSamples(frames) * static_cast<qsizetype>(sizeof(double)));
+}
+
+/* FNV-1a over 64 bit words. A change to any single word always changes
+ * the result, which is what a torn or damaged file needs. */
+static quint64 checksum(quint64 hash, const uchar *data, qsizetype size)
+{
+    qsizetype i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * fnvPrime;
+    }
+    if (i < size) {
+        quint64 word = 0;
+        std::memcpy(&word, data + i, size - i);
+        hash = (hash ^ word) * fnvPrime;
+    }
+    return hash;
+}
+
+static quint64 directoryChecksum(const uchar *directory, qsizetype size)
+{
+    auto hash = checksum(fnvOffset, directory, offsetof(Header, checksum));
+    return checksum(hash, directory + sizeof(Header),
+                    size - static_cast<qsizetype>(sizeof(Header)));
+}
+
+static quint64 blockChecksum(const uchar *data, qsizetype size)
+{
+    return checksum(fnvOffset, data, size);
+}
+
+/* Checks every block against its checksum, in parallel since it reads the
+ * whole file */
+static bool blocksIntact(const uchar *base, const QVector<quint64> &offsets,
+                         const uchar *sums, qsizetype frameCount)
+{
+    std::atomic<bool> intact{ true };
+    QVector<qsizetype> blocks(offsets.size());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    QtConcurrent::blockingMap(blocks, [&](qsizetype b) {
+        auto rows = std::min(FrameStore::blockSize,
+                             frameCount - FrameStore::blockStart(b));
+        quint64 expected;
+        std::memcpy(&expected, sums + (b * sizeof(quint64)), sizeof(quint64));
+        if (blockChecksum(base + offsets.at(b), FrameBlock::storedSize(rows))
+            != expected) {
+            intact = false;
+        }
+    });
+    return intact;
+}
+
+static qint64 modifiedTime(const QFileInfo &info)
+{
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+/* Blocks copied out of the mapped cache on first use, through the
+ * BlockCache */
+class MappedBlocks : public BlockSource
+{
+public:
+    MappedBlocks(std::unique_ptr<QFile> file, const uchar *base,
+                 QVector<quint64> offsets, qsizetype count)
+        : file(std::move(file)),
+          base(base),
+          offsets(std::move(offsets)),
+          count(count)
+    {
+    }
+    ~MappedBlocks() override { BlockCache::instance().remove(this); }
+
+    std::shared_ptr<const FrameBlock> load(qsizetype index) const override
+    {
+        return BlockCache::instance().get(this, index, [this, index]() {
+            auto rows = std::min(FrameStore::blockSize,
+                                 count - FrameStore::blockStart(index));
+            return FrameBlock::read(base + offsets.at(index), rows);
+        });
+    }
+
+private:
+    // The mapping lives as long as the file is open
+    std::unique_ptr<QFile> file;
+    const uchar *base;
+    QVector<quint64> offsets;
+    qsizetype count;
+};
+
+static QDir cacheDir()
+{
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    return QDir(dir.filePath("traces"));
+}
+
+QString TraceCache::cachePath(const QString &source)
+{
+    auto key = QCryptographicHash::hash(
+                       QFileInfo(source).absoluteFilePath().toUtf8(),
+                       QCryptographicHash::Sha1)
+                       .toHex();
+    return cacheDir().filePath(QString("%1.trace").arg(QString(key)));
+}
+
+void TraceCache::prune(qint64 maxBytes)
+{
+    // Newest first, the files used last were touched by load()
+    auto files = cacheDir().entryInfoList({ "*.trace" }, QDir::Files,
+                                          QDir::Time);
+    qint64 total = 0;
+    for (const auto &file : files) {
+        total += file.size();
+        if (total > maxBytes) {
+            QFile::remove(file.absoluteFilePath());
+        }
+    }
+}
+
+std::optional<FrameStore> TraceCache::load(const QString &source)
+{
+    QFileInfo info(source);
+    if (!info.exists()) {
+        return std::nullopt;
+    }
+    auto path = cachePath(source);
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QFile::ReadOnly)) {
+        return std::nullopt;
+    }
+    auto fileSize = file->size();
+    if (fileSize < static_cast<qint64>(sizeof(Header))) {
+        return std::nullopt;
+    }
+    const auto *base = file->map(0, fileSize);
+    if (base == nullptr) {
+        return std::nullopt;
+    }
+
+    Header header;
+    std::memcpy(&header, base, sizeof(header));
+    if ((header.magic != magic) || (header.byteOrder != byteOrderMark)
+        || (header.version != version)
+        || (header.blockShift != FrameStore::blockShift)
+        || (header.timeStrideShift != TimeIndex::strideShift)
+        || (header.fileSize != static_cast<quint64>(fileSize))
+        || (header.sourceSize != static_cast<quint64>(info.size()))
+        || (header.sourceTime != modifiedTime(info))
+        || (header.frameCount > UINT32_MAX)
+        || (header.keyCount > header.frameCount)) {
+        return std::nullopt;
+    }
+    auto frameCount = static_cast<qsizetype>(header.frameCount);
+    auto keyCount = static_cast<qsizetype>(header.keyCount);
+    auto blockCount =
+            FrameStore::blockOf(frameCount + FrameStore::blockSize - 1);
+    auto dirSize = directorySize(blockCount, keyCount, frameCount);
+    auto sumsOffset = fileSize - (blockCount * qint64(sizeof(quint64)));
+    if ((dirSize > sumsOffset)
+        || (directoryChecksum(base, dirSize) != header.checksum)) {
+        return std::nullopt;
+    }
+
+    const auto *pos = base + sizeof(Header);
+    QVector<quint64> offsets(blockCount);
+    for (qsizetype b = 0; b < blockCount; b++) {
+        BlockEntry entry;
+        std::memcpy(&entry, pos, sizeof(entry));
+        pos += sizeof(entry);
+        auto rows = std::min(FrameStore::blockSize,
+                             frameCount - FrameStore::blockStart(b));
+        if ((entry.offset % alignment != 0)
+            || (entry.offset < static_cast<quint64>(dirSize))
+            || (entry.offset + FrameBlock::storedSize(rows)
+                > static_cast<quint64>(sumsOffset))) {
+            return std::nullopt;
+        }
+        offsets[b] = entry.offset;
+    }
+    if (!blocksIntact(base, offsets, base + sumsOffset, frameCount)) {
+        return std::nullopt;
+    }
+
+    const auto *rows = pos + (keyCount * sizeof(KeyEntry));
+    FrameStore::RowIndex rowIndex{};
+    rowIndex.reserve(keyCount);
+    quint64 total = 0;
+    for (qsizetype k = 0; k < keyCount; k++) {
+        KeyEntry entry;
+        std::memcpy(&entry, pos, sizeof(entry));
+        pos += sizeof(entry);
+        if ((entry.first > header.frameCount)
+            || (entry.count > header.frameCount - entry.first)) {
+            return std::nullopt;
+        }
+        QVector<uint32_t> list(static_cast<qsizetype>(entry.count));
+        std::memcpy(list.data(), rows + (entry.first * sizeof(uint32_t)),
+                    entry.count * sizeof(uint32_t));
+        rowIndex.insert(entry.key, list);
+        total += entry.count;
+    }
+    if (total != header.frameCount) {
+        return std::nullopt;
+    }
+
+    pos = rows + aligned(frameCount * sizeof(uint32_t));
+    QVector<double> samples(timeSamples(frameCount));
+    if (!samples.isEmpty()) {
+        std::memcpy(samples.data(), pos, samples.size() * sizeof(double));
+    }
+    TimeIndex timeIndex(std::move(samples), header.maxTime, frameCount);
+
+    // Marks the file as used for prune()
+    QFile touch(path);
+    if (touch.open(QFile::Append)) {
+        touch.setFileTime(QDateTime::currentDateTime(),
+                          QFileDevice::FileModificationTime);
+    }
+
+    auto blocks = std::make_shared<MappedBlocks>(std::move(file), base,
+                                                 std::move(offsets),
+                                                 frameCount);
+    return FrameStore(std::move(blocks), frameCount, std::move(timeIndex),
+                      std::move(rowIndex));
+}
+
+bool TraceCache::save(const QString &source, const FrameStore &frames)
+{
+    QFileInfo info(source);
+    auto path = cachePath(source);
+    if (!info.exists() || !QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return false;
+    }
+
+    auto keys = frames.frameKeys();
+    std::sort(keys.begin(), keys.end());
+    auto blockCount = frames.blockCount();
+    auto dirSize = directorySize(blockCount, keys.size(), frames.size());
+    QByteArray directory(dirSize, '\0');
+    auto *pos = reinterpret_cast<uchar *>(directory.data()) + sizeof(Header);
+
+    auto offset = static_cast<quint64>(dirSize);
+    for (qsizetype b = 0; b < blockCount; b++) {
+        BlockEntry entry{ offset };
+        std::memcpy(pos, &entry, sizeof(entry));
+        pos += sizeof(entry);
+        auto rows = std::min(FrameStore::blockSize,
+                             frames.size() - FrameStore::blockStart(b));
+        offset += FrameBlock::storedSize(rows);
+    }
+
+    auto *rows = pos + (keys.size() * sizeof(KeyEntry));
+    quint64 first = 0;
+    for (auto key : keys) {
+        auto list = frames.rows(FrameStore::keyChannel(key),
+                                FrameStore::keyId(key));
+        KeyEntry entry{ key, first, static_cast<quint64>(list.size()) };
+        std::memcpy(pos, &entry, sizeof(entry));
+        pos += sizeof(entry);
+        std::memcpy(rows + (first * sizeof(uint32_t)), list.constData(),
+                    list.size() * sizeof(uint32_t));
+        first += list.size();
+    }
+    const auto &samples = frames.times().samples();
+    if (!samples.isEmpty()) {
+        std::memcpy(rows + aligned(frames.size() * sizeof(uint32_t)),
+                    samples.constData(), samples.size() * sizeof(double));
+    }
+
+    Header header{};
+    header.magic = magic;
+    header.byteOrder = byteOrderMark;
+    header.version = version;
+    header.blockShift = FrameStore::blockShift;
+    header.timeStrideShift = TimeIndex::strideShift;
+    header.sourceSize = info.size();
+    header.sourceTime = modifiedTime(info);
+    header.frameCount = frames.size();
+    header.keyCount = keys.size();
+    header.fileSize = offset + (blockCount * sizeof(quint64));
+    header.maxTime = frames.times().maxTime();
+    std::memcpy(directory.data(), &header, sizeof(header));
+    header.checksum = directoryChecksum(
+            reinterpret_cast<const uchar *>(directory.constData()), dirSize);
+    std::memcpy(directory.data(), &header, sizeof(header));
+
+    // Written aside and renamed, a reader never maps a partial file
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly)) {
+        return false;
+    }
+    file.write(directory);
+    QVector<quint64> sums(blockCount);
+    QByteArray stored{};
+    for (qsizetype b = 0; b < blockCount; b++) {
+        stored.clear();
+        QBuffer buffer(&stored);
+        buffer.open(QIODevice::WriteOnly);
+        frames.block(b)->write(buffer);
+        sums[b] = blockChecksum(
+                reinterpret_cast<const uchar *>(stored.constData()),
+                stored.size());
+        file.write(stored);
+    }
+    file.write(reinterpret_cast<const char *>(sums.constData()),
+               blockCount * static_cast<qsizetype>(sizeof(quint64)));
+    if (!file.commit()) {
+        return false;
+    }
+    prune(maxTotalSize);
+    return true;
+}
+
+FrameStore TraceCache::open(const QString &source)
+{
+    if (auto cached = load(source)) {
+        return std::move(*cached);
+    }
+    auto frames = Parser::parse(source);
+    // Written from a copy sharing the blocks, the table does not wait
+    QThreadPool::globalInstance()->start(
+            [source, frames]() { save(source, frames); });
+    return frames;
+}
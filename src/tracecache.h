@@ -0,0 +1,32 @@
+#pragma once
+#include <optional>
+#include <QString>
+#include "framestore.h"
+
+/* Binary copy of a parsed trace kept in the user cache directory, keyed by
+ * the absolute path of the source file. It holds the frame columns block by
+ * block, the time index and the posting lists, along with the size and
+ * modification time of the source it was made from. On reopen the file is
+ * mapped and every block is checked against its checksum. The time index
+ * and posting lists are copied out, the blocks are copied out of the
+ * mapping when first used. */
+class TraceCache
+{
+public:
+    static constexpr quint32 version = 3;
+    // Cache files beyond this, least recently used first, are deleted
+    static constexpr qint64 maxTotalSize = qint64(4) << 30;
+
+    static QString cachePath(const QString &source);
+    /* Frames of source from its cache, nothing when there is no cache or it
+     * is stale, corrupt or of another version */
+    static std::optional<FrameStore> load(const QString &source);
+    /* Writes the cache of source, returns false when it cannot be written.
+     * Older caches are then pruned to maxTotalSize. */
+    static bool save(const QString &source, const FrameStore &frames);
+    /* Frames of source from its cache when valid, otherwise parsed and the
+     * cache rebuilt in the background */
+    static FrameStore open(const QString &source);
+    /* Deletes the least recently used caches until they fit in maxBytes */
+    static void prune(qint64 maxBytes);
+};
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+#include <QHash>
+#include <QtConcurrent>
+#include "tracestats.h"
+
+namespace {
+
+/* Running figures of one key over a span of frames. Periods use Welford
+ * sums so that spans merge without losing precision. */
+struct Partial
+{
+    quint64 count{ 0 };
+    quint64 txCount{ 0 };
+    double firstTime{ 0 };
+    double lastTime{ 0 };
+    quint64 periods{ 0 };
+    double mean{ 0 };
+    double m2{ 0 };
+    double minPeriod{ qInf() };
+    double maxPeriod{ -qInf() };
+    uint16_t dlcMask{ 0 };
+
+    void addPeriod(double period)
+    {
+        periods++;
+        auto delta = period - mean;
+        mean += delta / static_cast<double>(periods);
+        m2 += delta * (period - mean);
+        minPeriod = std::min(minPeriod, period);
+        maxPeriod = std::max(maxPeriod, period);
+    }
+
+    void add(double time, uint8_t dlc, uint8_t dir)
+    {
+        if (count == 0) {
+            firstTime = time;
+        } else {
+            addPeriod(time - lastTime);
+        }
+        lastTime = time;
+        count++;
+        txCount += (dir == CAN_DIR_TX) ? 1 : 0;
+        dlcMask |= static_cast<uint16_t>(1U << std::min<uint8_t>(dlc, 15));
+    }
+
+    /* Appends a later span, the gap between both is one more period */
+    void merge(const Partial &later)
+    {
+        if (later.count == 0) {
+            return;
+        }
+        if (count == 0) {
+            *this = later;
+            return;
+        }
+        addPeriod(later.firstTime - lastTime);
+        if (later.periods > 0) {
+            auto total = periods + later.periods;
+            auto delta = later.mean - mean;
+            mean += delta * static_cast<double>(later.periods)
+                    / static_cast<double>(total);
+            m2 += later.m2
+                    + delta * delta * static_cast<double>(periods)
+                            * static_cast<double>(later.periods)
+                            / static_cast<double>(total);
+            periods = total;
+            minPeriod = std::min(minPeriod, later.minPeriod);
+            maxPeriod = std::max(maxPeriod, later.maxPeriod);
+        }
+        count += later.count;
+        txCount += later.txCount;
+        lastTime = later.lastTime;
+        dlcMask |= later.dlcMask;
+    }
+};
+
+} // namespace
+
+QVector<MessageStats> TraceStats::compute(const FrameStore &frames)
+{
+    std::vector<QHash<quint64, Partial>> partials(frames.blockCount());
+    QVector<qsizetype> blocks(frames.blockCount());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    QtConcurrent::blockingMap(blocks, [&](qsizetype b) {
+        auto block = frames.block(b);
+        auto &partial = partials[b];
+        // Runs of one key are common, skip the lookup for them
+        quint64 lastKey = 0;
+        Partial *current = nullptr;
+        for (qsizetype i = 0; i < block->size(); i++) {
+            auto key = FrameStore::frameKey(block->channel.at(i),
+                                            block->id.at(i));
+            if ((current == nullptr) || (key != lastKey)) {
+                current = &partial[key];
+                lastKey = key;
+            }
+            current->add(block->time.at(i), block->dlc.at(i),
+                         block->dir.at(i));
+        }
+    });
+
+    QHash<quint64, Partial> merged{};
+    for (const auto &partial : partials) {
+        for (auto it = partial.cbegin(); it != partial.cend(); it++) {
+            merged[it.key()].merge(it.value());
+        }
+    }
+
+    auto keys = merged.keys();
+    std::sort(keys.begin(), keys.end());
+    QVector<MessageStats> stats{};
+    stats.reserve(keys.size());
+    for (auto key : keys) {
+        const auto &partial = merged[key];
+        MessageStats item{};
+        item.channel = FrameStore::keyChannel(key);
+        item.id = FrameStore::keyId(key);
+        item.count = partial.count;
+        item.txCount = partial.txCount;
+        item.firstTime = partial.firstTime;
+        item.lastTime = partial.lastTime;
+        item.dlcMask = partial.dlcMask;
+        if (partial.periods > 0) {
+            item.meanPeriod = partial.mean;
+            item.minPeriod = partial.minPeriod;
+            item.maxPeriod = partial.maxPeriod;
+            item.jitter = std::sqrt(partial.m2
+                                    / static_cast<double>(partial.periods));
+        }
+        stats.append(item);
+    }
+    return stats;
+}
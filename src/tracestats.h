@@ -0,0 +1,33 @@
+#pragma once
+#include <QVector>
+#include "canmsg.h"
+#include "framestore.h"
+
+/* Timing and content figures of the frames of one (channel, id) */
+struct MessageStats
+{
+    uint8_t channel{ 0 };
+    uint32_t id{ 0 };
+    quint64 count{ 0 };
+    quint64 txCount{ 0 };
+    double firstTime{ 0 };
+    double lastTime{ 0 };
+    // Periods between consecutive frames, NaN with a single frame
+    double meanPeriod{ qQNaN() };
+    double minPeriod{ qQNaN() };
+    double maxPeriod{ qQNaN() };
+    double jitter{ qQNaN() };
+    // Bit n set when a frame had DLC n
+    uint16_t dlcMask{ 0 };
+
+    quint64 rxCount() const { return count - txCount; }
+};
+
+class TraceStats
+{
+public:
+    /* One pass over the blocks on the thread pool, each block aggregating
+     * its own partials that are merged in block order at the end. Results
+     * are ordered by channel, then id. */
+    static QVector<MessageStats> compute(const FrameStore &frames);
+};
@@ -0,0 +1,147 @@
+#include <array>
+#include <cmath>
+#include <QStringList>
+#include "tracestatsmodel.h"
+
+constexpr double msPerSecond = 1000;
+
+enum Column {
+    ChanColumn,
+    IdColumn,
+    NameColumn,
+    CountColumn,
+    FirstColumn,
+    LastColumn,
+    MeanColumn,
+    MinColumn,
+    MaxColumn,
+    JitterColumn,
+    DlcColumn,
+    TxColumn,
+    RxColumn
+};
+
+TraceStatsModel::TraceStatsModel(const CanDb &db, QObject *parent)
+    : QAbstractTableModel(parent), db(db)
+{
+}
+
+int TraceStatsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(stats.size());
+}
+
+void TraceStatsModel::setStats(const QVector<MessageStats> &stats)
+{
+    beginResetModel();
+    this->stats = stats;
+    endResetModel();
+}
+
+void TraceStatsModel::dbChanged()
+{
+    if (!stats.isEmpty()) {
+        emit dataChanged(index(0, NameColumn),
+                         index(static_cast<int>(stats.size()) - 1, NameColumn));
+    }
+}
+
+QVariant TraceStatsModel::value(const MessageStats &item, int column) const
+{
+    switch (column) {
+    case ChanColumn:
+        return item.channel;
+    case IdColumn:
+        return item.id;
+    case NameColumn: {
+        const auto *msg = db.findMessage(item.id);
+        return (msg != nullptr) ? msg->name : QString();
+    }
+    case CountColumn:
+        return item.count;
+    case FirstColumn:
+        return item.firstTime;
+    case LastColumn:
+        return item.lastTime;
+    case MeanColumn:
+        return item.meanPeriod * msPerSecond;
+    case MinColumn:
+        return item.minPeriod * msPerSecond;
+    case MaxColumn:
+        return item.maxPeriod * msPerSecond;
+    case JitterColumn:
+        return item.jitter * msPerSecond;
+    case DlcColumn:
+        return item.dlcMask;
+    case TxColumn:
+        return item.txCount;
+    case RxColumn:
+        return item.rxCount();
+    default:
+        return {};
+    }
+}
+
+QVariant TraceStatsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (index.row() >= stats.size())) {
+        return {};
+    }
+    const auto &item = stats.at(index.row());
+    if (role == Qt::UserRole) {
+        return value(item, index.column());
+    }
+    if (role == Qt::TextAlignmentRole) {
+        return (index.column() == NameColumn)
+                ? QVariant()
+                : QVariant(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+    auto cell = value(item, index.column());
+    switch (index.column()) {
+    case IdColumn:
+        return CanMessage::formatId(item.id);
+    case FirstColumn:
+    case LastColumn:
+        return QString::number(cell.toDouble(), 'f', 4);
+    case MeanColumn:
+    case MinColumn:
+    case MaxColumn:
+    case JitterColumn:
+        // A single frame has no period
+        return std::isnan(cell.toDouble())
+                ? QString()
+                : QString::number(cell.toDouble(), 'f', 3);
+    case DlcColumn: {
+        QStringList dlcs{};
+        for (int dlc = 0; dlc < 16; dlc++) {
+            if ((item.dlcMask & (1U << dlc)) != 0) {
+                dlcs.append(QString::number(dlc));
+            }
+        }
+        return dlcs.join(' ');
+    }
+    default:
+        return cell;
+    }
+}
+
+QVariant TraceStatsModel::headerData(int section, Qt::Orientation orientation,
+                                     int role) const
+{
+    static std::array<QString, columnCnt> const headers = {
+        tr("Chan"),         tr("CAN ID"),         tr("Message name"),
+        tr("Frames"),       tr("First"),          tr("Last"),
+        tr("Period (ms)"),  tr("Min period (ms)"), tr("Max period (ms)"),
+        tr("Jitter (ms)"),  tr("DLC"),            tr("Tx"),
+        tr("Rx")
+    };
+
+    if ((role != Qt::DisplayRole) || (orientation != Qt::Horizontal)
+        || (section < 0) || (section >= columnCnt)) {
+        return {};
+    }
+    return headers.at(section);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <QAbstractTableModel>
+#include "canmsg.h"
+#include "tracestats.h"
+
+/* One row per (channel, id) of the log. Qt::UserRole gives the raw value
+ * of a cell, for sorting. */
+class TraceStatsModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    TraceStatsModel(const CanDb &db, QObject *parent = nullptr);
+
+    static constexpr int columnCnt = 13;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount([[maybe_unused]] const QModelIndex &parent =
+                            QModelIndex()) const override
+    {
+        return columnCnt;
+    }
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    void setStats(const QVector<MessageStats> &stats);
+
+public slots:
+    void dbChanged();
+
+private:
+    QVariant value(const MessageStats &item, int column) const;
+
+    QVector<MessageStats> stats{};
+    const CanDb &db;
+};
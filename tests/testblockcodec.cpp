@@ -0,0 +1,94 @@
+#include <cmath>
+#include <cstring>
+#include <QTest>
+#include "blockcodec.h"
+
+class TestBlockCodec : public QObject
+{
+    Q_OBJECT
+private:
+    static void compareBlocks(const FrameBlock &actual,
+                              const FrameBlock &expected)
+    {
+        QCOMPARE(actual.size(), expected.size());
+        for (qsizetype i = 0; i < expected.size(); i++) {
+            // Bitwise, NaN included
+            QVERIFY(std::memcmp(&actual.time.at(i), &expected.time.at(i),
+                                sizeof(double))
+                    == 0);
+            QCOMPARE(actual.id.at(i), expected.id.at(i));
+            QCOMPARE(actual.number.at(i), expected.number.at(i));
+            QCOMPARE(actual.channel.at(i), expected.channel.at(i));
+            QCOMPARE(actual.dlc.at(i), expected.dlc.at(i));
+            QCOMPARE(actual.dir.at(i), expected.dir.at(i));
+            QCOMPARE(actual.data.at(i), expected.data.at(i));
+        }
+    }
+
+private slots:
+    void periodic()
+    {
+        // Ten messages every 10 ms with a counter and a slow signal, ASC
+        // and BLF style times
+        for (auto blf : { false, true }) {
+            FrameBlock block;
+            for (qsizetype i = 0; i < FrameStore::blockSize; i++) {
+                CanLogMsg frame;
+                auto micros = static_cast<quint64>(i) * 1000 + (i % 10);
+                frame.time = blf ? 1e-9 * static_cast<double>(micros * 1000)
+                                 : static_cast<double>(micros / 1000000)
+                                + static_cast<double>(micros % 1000000) / 1e6;
+                frame.number = static_cast<uint32_t>(i);
+                frame.id = 0x100 + static_cast<uint32_t>(i % 10);
+                frame.channel = 1;
+                frame.data[0] = static_cast<uint8_t>(i / 10);
+                frame.data[4] = static_cast<uint8_t>(i / 1000);
+                block.append(frame);
+            }
+            auto bytes = BlockCodec::encode(block);
+            QVERIFY(bytes.size() * 3 < block.bytes());
+            compareBlocks(*BlockCodec::decode(bytes), block);
+        }
+    }
+
+    void irregular()
+    {
+        FrameBlock block;
+        for (uint32_t i = 0; i < 1000; i++) {
+            CanLogMsg frame;
+            frame.number = i * 7919;
+            frame.id = i * 2654435761u;
+            frame.channel = static_cast<uint8_t>(i);
+            frame.dlc = static_cast<uint8_t>(i % 20);
+            frame.dir = static_cast<uint8_t>(i % 9);
+            frame.time = (i % 3 == 0) ? -1e300 * i : 1.0 / (i + 1);
+            if (i % 50 == 0) {
+                frame.time = qQNaN();
+            }
+            for (auto &byte : frame.data) {
+                byte = static_cast<uint8_t>(i * 31 + byte);
+            }
+            block.append(frame);
+        }
+        compareBlocks(*BlockCodec::decode(BlockCodec::encode(block)), block);
+        QCOMPARE(BlockCodec::decode(BlockCodec::encode({}))->size(), qsizetype(0));
+    }
+
+    void truncated()
+    {
+        FrameBlock block;
+        for (uint32_t i = 0; i < 100; i++) {
+            CanLogMsg frame;
+            frame.number = i;
+            block.append(frame);
+        }
+        auto bytes = BlockCodec::encode(block);
+        for (qsizetype size = 0; size < bytes.size(); size++) {
+            QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                     BlockCodec::decode(bytes.left(size)));
+        }
+    }
+};
+
+QTEST_MAIN(TestBlockCodec)
+#include "testblockcodec.moc"
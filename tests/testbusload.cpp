@@ -0,0 +1,48 @@
+#include <QTest>
+#include "busload.h"
+#include "framestore.h"
+
+class TestBusLoad : public QObject
+{
+    Q_OBJECT
+private slots:
+    void frameBits()
+    {
+        // Worst case lengths of classic CAN frames
+        QCOMPARE(BusLoad::frameBits(0x100, 8), 135);
+        QCOMPARE(BusLoad::frameBits(0x100, 0), 55);
+        QCOMPARE(BusLoad::frameBits(0x18FEF100, 8), 160);
+        QCOMPARE(BusLoad::frameBits(0x18FEF100, 0), 80);
+    }
+
+    void compute()
+    {
+        FrameStore frames;
+        // 1000 frames of 135 bits per second on channel 1 over two blocks,
+        // one per 100 ms on channel 2
+        auto count = FrameStore::blockSize + 1000;
+        for (qsizetype i = 0; i < count; i++) {
+            CanLogMsg frame;
+            frame.time = static_cast<double>(i) / 1000;
+            frame.id = 0x100;
+            frame.channel = (i % 100 == 0) ? 2 : 1;
+            frames.append(frame);
+        }
+        auto graphs = BusLoad::compute(frames, 500000, 1.0);
+        QCOMPARE(graphs.size(), 2);
+        const auto &chan1 = graphs.value(1);
+        const auto &chan2 = graphs.value(2);
+        QCOMPARE(chan1.size(), count / 1000 + 1);
+        QCOMPARE(chan1.first().first, 0.0);
+        QCOMPARE(chan1.at(1).first, 1.0);
+        // 990 frames in a second of a 500 kbit/s bus
+        QVERIFY(qFuzzyCompare(chan1.at(50).second, 990 * 135 * 100 / 500000.0));
+        QVERIFY(qFuzzyCompare(chan2.at(50).second, 10 * 135 * 100 / 500000.0));
+
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 BusLoad::compute(frames, 500000, 1e-9));
+    }
+};
+
+QTEST_MAIN(TestBusLoad)
+#include "testbusload.moc"
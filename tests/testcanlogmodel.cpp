@@ -0,0 +1,110 @@
+#include <stdexcept>
+#include <QTest>
+#include <QBrush>
+#include <QSet>
+#include <QSignalSpy>
+#include "canlogmodel.h"
+
+class TestCanLogModel : public QObject
+{
+    Q_OBJECT
+private:
+    /* Both sides of the standard ID table, and an extended ID sharing its
+     * low bits with the first one */
+    static constexpr uint32_t ids[] = { 0x100, 0x7FF, 0x800, 0x18FEF100 };
+    static constexpr int frameCount = 200;
+
+    static CanLogMsg makeFrame(int row)
+    {
+        CanLogMsg frame;
+        frame.number = static_cast<uint32_t>(row);
+        frame.id = ids[row % 4];
+        frame.channel = 1 + (row / 4) % 2;
+        frame.dlc = row % 9;
+        return frame;
+    }
+
+    static QColor background(const CanLogModel &model, int row)
+    {
+        auto value = model.data(model.index(row, 0, {}), Qt::BackgroundRole);
+        return value.isValid() ? value.value<QBrush>().color() : QColor();
+    }
+
+private slots:
+    void highlights()
+    {
+        FrameStore frames{};
+        for (int row = 0; row < frameCount; row++) {
+            frames.append(makeFrame(row));
+        }
+        CanDb db;
+        CanLogModel model(frames, db);
+        model.logChanged();
+
+        const QColor marked(Qt::yellow);
+        const QColor idColor(Qt::green);
+        const QColor first(Qt::red);
+        const QColor second(Qt::blue);
+        int markedRow = -1;
+        QSet<uint32_t> markedIds{};
+        bool withRules = true;
+        // First row showing another colour than it should, -1 when none
+        auto mismatch = [&]() {
+            for (int row = 0; row < frameCount; row++) {
+                auto frame = makeFrame(row);
+                QColor expected{};
+                if (row == markedRow) {
+                    expected = marked;
+                } else if (markedIds.contains(frame.id)) {
+                    expected = idColor;
+                } else if (withRules && (frame.dlc < 8)
+                           && (frame.channel == 2)) {
+                    expected = first;
+                } else if (withRules && (frame.channel == 2)) {
+                    expected = second;
+                }
+                if (background(model, row) != expected) {
+                    return row;
+                }
+            }
+            return -1;
+        };
+
+        QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+        // Earlier rules win where both match
+        model.addHighlightRule("dlc < 8 && chan == 2", first);
+        model.addHighlightRule("chan == 2", second);
+        QCOMPARE(changed.count(), 2);
+        QCOMPARE(model.highlightRuleCount(), 2);
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 model.addHighlightRule("dlc <", first));
+        QCOMPARE(model.highlightRuleCount(), 2);
+        QCOMPARE(mismatch(), -1);
+
+        // Marked IDs and rows cover the rules
+        model.setHighlightId(model.index(0, 0, {}), true);
+        markedIds.insert(ids[0]);
+        QCOMPARE(mismatch(), -1);
+        model.setHighlightId(model.index(3, 0, {}), true);
+        markedIds.insert(ids[3]);
+        QCOMPARE(mismatch(), -1);
+        model.setHighlightMsg(model.index(7, 0, {}), true);
+        markedRow = 7;
+        QCOMPARE(mismatch(), -1);
+        QVERIFY(model.isIdHighlight(model.index(4, 0, {})));
+        QVERIFY(!model.isIdHighlight(model.index(6, 0, {})));
+
+        model.clearHighlightRules();
+        withRules = false;
+        QCOMPARE(model.highlightRuleCount(), 0);
+        QCOMPARE(mismatch(), -1);
+
+        model.setHighlightId(model.index(3, 0, {}), false);
+        markedIds.remove(ids[3]);
+        QCOMPARE(mismatch(), -1);
+        QVERIFY(model.isMsgHighlight(model.index(7, 0, {})));
+    }
+};
+
+QTEST_MAIN(TestCanLogModel)
+#include "testcanlogmodel.moc"
@@ -1,5 +1,29 @@
+#include <algorithm>
+#include <QRandomGenerator>
 #include <QTest>
 #include "canmsg.h"
+#include "signaldecoder.h"
+
+// Big endian raw value as the byte walk of parseSignal() used to read it
+static double motorolaRaw(const CanSignal &signal, const CanData &input)
+{
+    uint64_t raw = 0;
+    auto startBit = signal.startBit;
+    auto len = signal.len;
+    while (len != 0) {
+        auto remain = startBit % 8;
+        auto bits = std::min<int>(8 - remain, len);
+        raw = (raw << 8) + GetNbit(input.at(startBit / 8) >> remain, bits);
+        startBit += bits;
+        len -= bits;
+    }
+    if (signal.isSigned && ((raw >> (signal.len - 1)) != 0)) {
+        uint64_t mask = (signal.len == 64) ? UINT64_MAX
+                                           : ((uint64_t(1) << signal.len) - 1);
+        return static_cast<int64_t>(raw - mask - 1);
+    }
+    return static_cast<double>(raw);
+}
 
 class TestCanMsg : public QObject
 {
@@ -39,6 +63,125 @@ private slots:
         signal.isSigned = true;
         QCOMPARE(CanSignal::parseSignal(signal, data, 2), -238);
     }
+
+    void testCanDbSignalPlan()
+    {
+        CanMessage msg;
+        msg.addCanSignal(CanSignal(4, 8, false, false, 1, 0));
+        msg.addCanSignal(CanSignal(8, 32, true, false, 1, 0));
+        msg.addCanSignal(CanSignal(8, 32, false, true, 1, 0));
+
+        CanData data = { 0x21, 0x43, 0x02, 0x03, 0x84 };
+        QCOMPARE(CanSignal::parseSignal(msg.canSignals.at(0), data, 2), 0x32);
+        QCOMPARE(CanSignal::parseSignal(msg.canSignals.at(1), data, 5),
+                 0x43020384);
+        QCOMPARE(CanSignal::parseSignal(msg.canSignals.at(2), data, 5),
+                 static_cast<int32_t>(0x84030243));
+        QVERIFY(qIsNaN(CanSignal::parseSignal(msg.canSignals.at(1), data, 4)));
+    }
+
+    void testCanDbParseBigEndian()
+    {
+        CanSignal signal(4, 12, true, false, 1, 0);
+        CanData data = { 0xA0, 0x12 };
+        QCOMPARE(CanSignal::parseSignal(signal, data, 2), 0xA12);
+
+        auto *random = QRandomGenerator::global();
+        for (int i = 0; i < 200; i++) {
+            random->fillRange(reinterpret_cast<quint32 *>(data.data()), 2);
+            for (uint8_t start = 0; start < 64; start++) {
+                for (uint8_t len = 1; start + len <= 64; len++) {
+                    for (auto isSigned : { false, true }) {
+                        CanSignal be(start, len, true, isSigned, 1, 0);
+                        QCOMPARE(CanSignal::parseSignal(be, data, 8),
+                                 motorolaRaw(be, data));
+                    }
+                }
+            }
+        }
+    }
+
+    void testSignalDecoder()
+    {
+        QVector<CanData> payloads{};
+        QVector<uint8_t> dlc{};
+        for (uint8_t i = 0; i < 11; i++) {
+            payloads.append({ uint8_t(i * 37), uint8_t(i * 91), uint8_t(~i),
+                              uint8_t(i << 4), 0x80, i, 0xFF, uint8_t(i) });
+            dlc.append((i == 5) ? 2 : CAN_MAX_DLC);
+        }
+        const QVector<CanSignal> signalList{
+            CanSignal(0, 16, true, false, 1, 0),
+            CanSignal(3, 12, false, true, 0.5, -4),
+            CanSignal(8, 24, true, true, 2, 1),
+            CanSignal(4, 60, false, false, 1, 0),
+        };
+        for (const auto &signal : signalList) {
+            auto values = SignalDecoder::decode(signal, payloads, dlc);
+            QCOMPARE(values.size(), payloads.size());
+            for (qsizetype i = 0; i < payloads.size(); i++) {
+                auto expected = CanSignal::parseSignal(signal, payloads.at(i),
+                                                       dlc.at(i));
+                if (qIsNaN(expected)) {
+                    QVERIFY(qIsNaN(values.at(i)));
+                } else {
+                    QCOMPARE(values.at(i), expected);
+                }
+            }
+        }
+    }
+
+    void testSignalDecoderKernels()
+    {
+        QVector<CanData> payloads(67);
+        QVector<uint8_t> dlc{};
+        QVector<uint32_t> rows{};
+        auto *random = QRandomGenerator::global();
+        for (qsizetype i = 0; i < payloads.size(); i++) {
+            random->fillRange(
+                    reinterpret_cast<quint32 *>(payloads[i].data()), 2);
+            dlc.append((i % 13 == 5) ? 3 : CAN_MAX_DLC);
+            rows.append(static_cast<uint32_t>((i * 29) % payloads.size()));
+        }
+        const QVector<CanSignal> signalList{
+            CanSignal(4, 12, true, false, 1, 0),
+            CanSignal(4, 12, true, true, 0.5, 3),
+            CanSignal(13, 27, true, true, 1, 0),
+            CanSignal(7, 41, true, false, 2, -1),
+            CanSignal(3, 40, true, true, 1, 0),
+            CanSignal(5, 11, false, true, 1, 0),
+            CanSignal(9, 47, false, false, 0.1, 0),
+            CanSignal(16, 16, true, true, 1, 0),
+        };
+        const SignalDecoder::Isa isaList[]{ SignalDecoder::Isa::Sse42,
+                                            SignalDecoder::Isa::Avx2 };
+        for (const auto &signal : signalList) {
+            const uint32_t *noRows = nullptr;
+            for (const auto *frames : { rows.constData(), noRows }) {
+                QVector<double> expected(payloads.size());
+                SignalDecoder::decode(SignalDecoder::Isa::Scalar, signal,
+                                      payloads.constData(), dlc.constData(),
+                                      frames, payloads.size(),
+                                      expected.data());
+                for (auto isa : isaList) {
+                    if (!SignalDecoder::supported(isa)) {
+                        continue;
+                    }
+                    QVector<double> values(payloads.size());
+                    SignalDecoder::decode(isa, signal, payloads.constData(),
+                                          dlc.constData(), frames,
+                                          payloads.size(), values.data());
+                    for (qsizetype i = 0; i < values.size(); i++) {
+                        if (qIsNaN(expected.at(i))) {
+                            QVERIFY(qIsNaN(values.at(i)));
+                        } else {
+                            QCOMPARE(values.at(i), expected.at(i));
+                        }
+                    }
+                }
+            }
+        }
+    }
 };
 
 QTEST_MAIN(TestCanMsg)
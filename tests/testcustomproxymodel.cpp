@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <QTest>
+#include <QAbstractItemModelTester>
+#include <QItemSelectionModel>
+#include <QPersistentModelIndex>
+#include <QSignalSpy>
+#include "canlogmodel.h"
+#include "customproxymodel.h"
+
+class TestCustomProxyModel : public QObject
+{
+    Q_OBJECT
+private:
+    static constexpr int frameCount = 100;
+    static constexpr int channelColumn = 2;
+    static constexpr int idColumn = 3;
+
+    /* Frames alternate between channel 1 and 2 and cycle through five
+     * ids, the second of which has two signals */
+    static FrameStore makeFrames()
+    {
+        FrameStore frames{};
+        for (int i = 0; i < frameCount; i++) {
+            CanLogMsg frame;
+            frame.number = static_cast<uint32_t>(i);
+            frame.time = i / 100.0;
+            frame.channel = 1 + i % 2;
+            frame.id = 0x100 + i % 5;
+            frame.data[0] = static_cast<uint8_t>(i);
+            frames.append(frame);
+        }
+        return frames;
+    }
+
+    static CanDb makeDatabase()
+    {
+        CanDb db;
+        CanMessage msg;
+        msg.id = 0x101;
+        msg.name = "Status";
+        CanSignal first(0, 8, false, false, 1, 0);
+        first.name = "First";
+        msg.addCanSignal(first);
+        CanSignal second(8, 8, false, false, 1, 0);
+        second.name = "Second";
+        msg.addCanSignal(second);
+        db.addMessage(msg);
+        return db;
+    }
+
+    static QVector<int> sourceRows(const CustomProxyModel &proxy)
+    {
+        QVector<int> rows{};
+        for (int row = 0; row < proxy.rowCount(); row++) {
+            rows.append(proxy.mapToSource(proxy.index(row, 0)).row());
+        }
+        return rows;
+    }
+
+    static QVector<int> selectedSourceRows(const CustomProxyModel &proxy,
+                                           const QItemSelectionModel &selection)
+    {
+        QVector<int> rows{};
+        for (const auto &index : selection.selectedRows()) {
+            rows.append(proxy.mapToSource(index).row());
+        }
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    }
+
+    /* Waits for the filter run in flight to be swapped in */
+    static bool waitForRun(CustomProxyModel &proxy)
+    {
+        QSignalSpy spy(&proxy, &QAbstractItemModel::layoutChanged);
+        return spy.wait();
+    }
+
+private slots:
+    void filterSortRefilter()
+    {
+        auto frames = makeFrames();
+        auto db = makeDatabase();
+        CanLogModel source(frames, db);
+        source.logChanged();
+        CustomProxyModel proxy{};
+        proxy.setSourceModel(&source);
+        QAbstractItemModelTester tester(
+                &proxy, QAbstractItemModelTester::FailureReportingMode::QtTest);
+        QItemSelectionModel selection(&proxy);
+        QCOMPARE(proxy.rowCount(), frameCount);
+
+        selection.setCurrentIndex(proxy.index(51, 0),
+                                  QItemSelectionModel::NoUpdate);
+        for (int row : { 51, 53 }) {
+            selection.select(proxy.index(row, 0),
+                             QItemSelectionModel::Select
+                                     | QItemSelectionModel::Rows);
+        }
+        QPersistentModelIndex signalIndex(
+                proxy.index(1, 0, selection.currentIndex()));
+        QVERIFY(signalIndex.isValid());
+
+        // Channel 2 carries the odd rows
+        QVector<int> odd{};
+        for (int row = 1; row < frameCount; row += 2) {
+            odd.append(row);
+        }
+        proxy.setFilter(channelColumn, "^2$");
+        // The rows stay as they are until the run is done
+        QCOMPARE(proxy.rowCount(), frameCount);
+        QVERIFY(waitForRun(proxy));
+        QCOMPARE(sourceRows(proxy), odd);
+        QCOMPARE(selection.currentIndex().row(), 25);
+        QCOMPARE(selectedSourceRows(proxy, selection),
+                 (QVector<int>{ 51, 53 }));
+
+        proxy.sort(0, Qt::DescendingOrder);
+        QVERIFY(waitForRun(proxy));
+        auto descending = odd;
+        std::reverse(descending.begin(), descending.end());
+        QCOMPARE(sourceRows(proxy), descending);
+        QCOMPARE(selection.currentIndex().row(), 24);
+        QCOMPARE(proxy.mapToSource(selection.currentIndex()).row(), 51);
+        QCOMPARE(selectedSourceRows(proxy, selection),
+                 (QVector<int>{ 51, 53 }));
+
+        // Signal rows map through the proxy row of their frame
+        QCOMPARE(signalIndex.parent(), selection.currentIndex());
+        QCOMPARE(proxy.rowCount(signalIndex.parent()), 2);
+        auto sourceSignal = proxy.mapToSource(signalIndex);
+        QCOMPARE(sourceSignal.row(), 1);
+        QCOMPARE(sourceSignal.parent().row(), 51);
+        QCOMPARE(proxy.mapFromSource(sourceSignal), QModelIndex(signalIndex));
+
+        /* A run superseded before it is done is never shown, only the
+         * newest one is */
+        QVector<int> shownRows{};
+        connect(&proxy, &QAbstractItemModel::layoutChanged, &proxy,
+                [&]() { shownRows.append(proxy.rowCount()); });
+        proxy.setFilter(idColumn, "101");
+        proxy.setFilter(idColumn, "");
+        QCOMPARE(proxy.rowCount(), static_cast<int>(odd.size()));
+        QVERIFY(waitForRun(proxy));
+        QTest::qWait(100);
+        QCOMPARE(shownRows, QVector<int>{ static_cast<int>(odd.size()) });
+        QCOMPARE(sourceRows(proxy), descending);
+        QCOMPARE(proxy.mapToSource(selection.currentIndex()).row(), 51);
+        QCOMPARE(proxy.mapToSource(signalIndex).parent().row(), 51);
+
+        // A reset with as many rows keeps the mapping until the next run
+        source.logChanged();
+        QCOMPARE(sourceRows(proxy), descending);
+        QVERIFY(waitForRun(proxy));
+        QCOMPARE(sourceRows(proxy), descending);
+
+        // Without filter and sort the rows map one to one right away
+        proxy.setFilter(channelColumn, "");
+        proxy.sort(-1);
+        QCOMPARE(proxy.rowCount(), frameCount);
+        QCOMPARE(proxy.mapToSource(proxy.index(51, 0)).row(), 51);
+    }
+};
+
+QTEST_MAIN(TestCustomProxyModel)
+#include "testcustomproxymodel.moc"
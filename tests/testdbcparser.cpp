@@ -19,6 +19,33 @@ private slots:
         QCOMPARE(db.messageCount(), 1);
         QCOMPARE(db.at(0).signalCount(), 1);
     }
+
+    void lookup()
+    {
+        QString text =
+                "BO_ 291 std: 8 Bob\n"
+                " SG_ a : 0|8@1+ (1,0) [0|255] \"\" Alice\n"
+                " SG_ b : 8|8@1+ (1,0) [0|255] \"\" Alice\n"
+                "\n"
+                "BO_ 2566844926 ext: 8 Bob\n"
+                " SG_ c : 0|8@1+ (1,0) [0|255] \"\" Alice\n"
+                "\n"
+                "VAL_ 291 b 0 \"off\" 1 \"on\" ;\n";
+        QTextStream stream(&text);
+        CanDb db;
+        DbcParser::parseStream(stream, db);
+        QCOMPARE(db.messageCount(), 2);
+        auto *msg = db.findMessage(0x123);
+        QVERIFY(msg != nullptr);
+        QCOMPARE(msg->name, QString("std"));
+        QCOMPARE(msg->findSignal("b")->getValuePairs().size(), 2);
+        QVERIFY(msg->findSignal("c") == nullptr);
+        msg = db.findMessage(0x18FEF1FE);
+        QVERIFY(msg != nullptr);
+        QCOMPARE(msg->name, QString("ext"));
+        QVERIFY(db.findMessage(0x124) == nullptr);
+        QVERIFY(db.findMessage(0x18FEF1FF) == nullptr);
+    }
 };
 
 QTEST_MAIN(TestDbcParser)
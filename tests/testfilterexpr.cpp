@@ -0,0 +1,84 @@
+#include <QTest>
+#include "canmsg.h"
+#include "filterexpr.h"
+#include "framestore.h"
+
+class TestFilterExpr : public QObject
+{
+    Q_OBJECT
+private:
+    static QVector<qsizetype> matches(const QString &text,
+                                      const FrameStore &frames,
+                                      const CanDb &db)
+    {
+        auto bitmap = FilterExpr::compile(text, db).evaluate(frames);
+        QVector<qsizetype> rows{};
+        for (qsizetype row = 0; row < frames.size(); row++) {
+            if (testRow(bitmap, row)) {
+                rows.append(row);
+            }
+        }
+        return rows;
+    }
+
+private slots:
+    void evaluate()
+    {
+        CanDb db;
+        CanMessage msg;
+        msg.id = 0x100;
+        CanSignal signal(0, 16, false, false, 1, 0);
+        signal.name = "Speed";
+        msg.addCanSignal(signal);
+        db.addMessage(msg);
+
+        FrameStore frames;
+        // Spans two blocks so the parallel evaluation meets a block edge
+        auto count = FrameStore::blockSize + 10;
+        for (qsizetype i = 0; i < count; i++) {
+            CanLogMsg frame;
+            frame.number = static_cast<uint32_t>(i);
+            frame.time = static_cast<double>(i) / 100;
+            frame.id = (i % 2 == 0) ? 0x100 : 0x200;
+            frame.channel = (i % 3 == 0) ? 1 : 2;
+            frame.dir = (i % 5 == 0) ? CAN_DIR_TX : CAN_DIR_RX;
+            frame.data[0] = static_cast<uint8_t>(i);
+            frame.data[1] = static_cast<uint8_t>(i >> 8);
+            frames.append(frame);
+        }
+
+        QCOMPARE(matches("", frames, db).size(), count);
+        QCOMPARE(matches("no == 7", frames, db), QVector<qsizetype>{ 7 });
+        QCOMPARE(matches("id == 0x200 && no < 6", frames, db),
+                 (QVector<qsizetype>{ 1, 3, 5 }));
+        QCOMPARE(matches("chan == 1 && dir == tx && no in 0..40", frames, db),
+                 (QVector<qsizetype>{ 0, 15, 30 }));
+        QCOMPARE(matches("!(no >= 3) || no == 9", frames, db).size(), 4);
+        QCOMPARE(matches("b0 == 0xFF && b1 == 1", frames, db),
+                 QVector<qsizetype>{ 0x1FF });
+        QCOMPARE(matches("t > 655.35 && id in 0x100..0x1FF", frames, db),
+                 (QVector<qsizetype>{ 65536, 65538, 65540, 65542, 65544 }));
+        // The signal only exists on 0x100, other ids never match
+        QCOMPARE(matches("Speed == 1000 || Speed == 1001", frames, db),
+                 QVector<qsizetype>{ 1000 });
+        QCOMPARE(matches("!(no > 1)", frames, db),
+                 (QVector<qsizetype>{ 0, 1 }));
+    }
+
+    void errors()
+    {
+        CanDb db;
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 FilterExpr::compile("id ==", db));
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 FilterExpr::compile("(id == 1", db));
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 FilterExpr::compile("Unknown > 3", db));
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 FilterExpr::compile("id == 1 $", db));
+        QVERIFY(FilterExpr::compile("  ", db).isEmpty());
+    }
+};
+
+QTEST_MAIN(TestFilterExpr)
+#include "testfilterexpr.moc"
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <QTest>
+#include "blockcache.h"
+#include "framestore.h"
+
+class TestFrameStore : public QObject
+{
+    Q_OBJECT
+private slots:
+    void spill()
+    {
+        // Room for a few blocks, the store below spills part way
+        auto limit = 16 * FrameStore::blockSize * FrameBlock::rowBytes;
+        BlockCache::setMemoryLimit(limit);
+        FrameStore frames;
+        auto count = (10 * FrameStore::blockSize) + 123;
+        for (qsizetype i = 0; i < count; i++) {
+            CanLogMsg frame;
+            frame.number = static_cast<uint32_t>(i);
+            frame.time = static_cast<double>(i) * 0.001;
+            frame.id = static_cast<uint32_t>(i % 7);
+            frame.data[0] = static_cast<uint8_t>(i);
+            frame.data[7] = static_cast<uint8_t>(i >> 16);
+            frames.append(frame);
+        }
+
+        for (qsizetype row = 0; row < count; row += 101) {
+            auto frame = frames.at(row);
+            QCOMPARE(frame.number, static_cast<uint32_t>(row));
+            QCOMPARE(frame.id, static_cast<uint32_t>(row % 7));
+            QCOMPARE(frame.data[0], static_cast<uint8_t>(row));
+            QCOMPARE(frame.data[7], static_cast<uint8_t>(row >> 16));
+        }
+        QVERIFY(frames.memoryBytes() <= BlockCache::residentLimit());
+        QCOMPARE(frames.block(frames.blockCount() - 1)->size(), qsizetype(123));
+        QCOMPARE(frames.rowAtTime(500.0), qsizetype(500000));
+        QCOMPARE(frames.rows(0, 3).size(), (count + 3) / 7);
+
+        // A copy appending to a spilled store keeps its own blocks
+        auto copy = frames;
+        CanLogMsg frame;
+        frame.time = 1e6;
+        for (qsizetype i = 0; i < 2 * FrameStore::blockSize; i++) {
+            copy.append(frame);
+        }
+        QCOMPARE(copy.time(count), 1e6);
+        QCOMPARE(copy.at(5).number, 5u);
+        QCOMPARE(frames.size(), count);
+        QCOMPARE(frames.at(count - 1).number,
+                 static_cast<uint32_t>(count - 1));
+
+        BlockCache::setMemoryLimit(BlockCache::defaultMemoryLimit);
+    }
+
+    void memoryAfterScan()
+    {
+        auto blockBytes = FrameStore::blockSize * FrameBlock::rowBytes;
+        auto limit = 24 * blockBytes;
+        BlockCache::setMemoryLimit(limit);
+        for (auto compress : { false, true }) {
+            FrameStore::setCompression(compress);
+            FrameStore frames;
+            for (qsizetype i = 0; i < 16 * FrameStore::blockSize; i++) {
+                CanLogMsg frame;
+                frame.number = static_cast<uint32_t>(i);
+                frame.time = static_cast<double>(i) * 0.001;
+                frame.id = static_cast<uint32_t>(i % 7);
+                frame.data[0] = static_cast<uint8_t>(i);
+                frames.append(frame);
+            }
+            quint64 sum = 0;
+            for (qsizetype b = 0; b < frames.blockCount(); b++) {
+                sum += frames.block(b)->number.last();
+            }
+            QVERIFY(sum > 0);
+
+            // Full blocks, posting lists, both caches and the block filled
+            auto total = frames.memoryBytes() + BlockCache::instance().size()
+                    + BlockCache::decoded().size() + blockBytes;
+            QVERIFY(total <= limit);
+            if (compress) {
+                // Less than the frames take uncompressed
+                QVERIFY(total < 16 * blockBytes);
+            }
+        }
+        FrameStore::setCompression(false);
+        BlockCache::setMemoryLimit(BlockCache::defaultMemoryLimit);
+    }
+
+    void timeIndex()
+    {
+        // Every 5th frame stamped a little late, as some BLF loggers do
+        FrameStore frames;
+        QVector<double> times{};
+        for (qsizetype i = 0; i < FrameStore::blockSize + 1000; i++) {
+            CanLogMsg frame;
+            frame.time = (static_cast<double>(i) * 0.001)
+                    + ((i % 5 == 0) ? 0.0025 : 0.0);
+            frames.append(frame);
+            times.append(frame.time);
+        }
+        auto firstRow = [&times](double time, bool inclusive) {
+            for (qsizetype row = 0; row < times.size(); row++) {
+                if (inclusive ? (times.at(row) >= time)
+                              : (times.at(row) > time)) {
+                    return row;
+                }
+            }
+            return times.size();
+        };
+
+        QCOMPARE(frames.startTime(), times.first());
+        QCOMPARE(frames.endTime(), *std::max_element(times.cbegin(),
+                                                     times.cend()));
+        for (double t = -1.0; t < 68.0; t += 0.0937) {
+            QCOMPARE(frames.rowAtTime(t), firstRow(t, true));
+            auto range = frames.framesBetween(t, t + 0.5);
+            QCOMPARE(range.first, firstRow(t, true));
+            QCOMPARE(range.last,
+                     std::max(range.first, firstRow(t + 0.5, false)));
+        }
+        QCOMPARE(frames.rowAtTime(times.at(12345)), qsizetype(12345));
+        QVERIFY(frames.framesBetween(100.0, 200.0).isEmpty());
+        QCOMPARE(FrameStore().rowAtTime(0), qsizetype(0));
+    }
+
+    void nearestRow()
+    {
+        FrameStore frames;
+        QCOMPARE(frames.nearestRow(1.0), qsizetype(-1));
+        // The fourth frame is stamped before the third
+        for (double time : { 1.0, 2.0, 4.0, 3.0, 6.0 }) {
+            CanLogMsg frame;
+            frame.time = time;
+            frames.append(frame);
+        }
+        QCOMPARE(frames.nearestRow(-5.0), qsizetype(0));
+        QCOMPARE(frames.nearestRow(1.0), qsizetype(0));
+        QCOMPARE(frames.nearestRow(1.4), qsizetype(0));
+        // Halfway between two frames
+        QCOMPARE(frames.nearestRow(1.5), qsizetype(1));
+        QCOMPARE(frames.nearestRow(2.9), qsizetype(1));
+        QCOMPARE(frames.nearestRow(3.4), qsizetype(2));
+        QCOMPARE(frames.nearestRow(5.0), qsizetype(4));
+        QCOMPARE(frames.nearestRow(6.0), qsizetype(4));
+        QCOMPARE(frames.nearestRow(100.0), qsizetype(4));
+    }
+};
+
+QTEST_MAIN(TestFrameStore)
+#include "testframestore.moc"
@@ -0,0 +1,248 @@
+#include <cstring>
+#include <QTest>
+#include <QTemporaryFile>
+#include <QDir>
+#include <QtEndian>
+#include "logparser.h"
+
+class TestLogParser : public QObject
+{
+    Q_OBJECT
+private:
+    static FrameStore parseText(const QByteArray &text,
+                                const QString &extension,
+                                qsizetype chunkSize = Parser::defaultChunkSize)
+    {
+        QTemporaryFile file(QDir::tempPath() + "/testXXXXXX." + extension);
+        if (!file.open()) {
+            return {};
+        }
+        file.write(text);
+        file.close();
+        return Parser::parse(file.fileName(), chunkSize);
+    }
+
+    template<typename T>
+    static void appendLe(QByteArray &bytes, T value)
+    {
+        char raw[sizeof(T)];
+        qToLittleEndian(value, raw);
+        bytes.append(raw, sizeof(T));
+    }
+
+    static QByteArray blfObject(quint32 type, quint16 headerSize,
+                                const QByteArray &body)
+    {
+        QByteArray obj("LOBJ");
+        appendLe<quint16>(obj, headerSize);
+        appendLe<quint16>(obj, 1); // Header version
+        appendLe<quint32>(obj, 16 + body.size());
+        appendLe<quint32>(obj, type);
+        obj.append(body);
+        obj.append(QByteArray(obj.size() % 4, '\0'));
+        return obj;
+    }
+
+    static QByteArray blfCanMessage(const CanLogMsg &msg, quint64 timestamp)
+    {
+        QByteArray body{};
+        appendLe<quint32>(body, 2); // Nanosecond timestamps
+        appendLe<quint32>(body, 0); // Client index, object version
+        appendLe<quint64>(body, timestamp);
+        appendLe<quint16>(body, msg.channel);
+        body.append('\0');
+        body.append(static_cast<char>(msg.dlc));
+        // Extended ids carry bit 31
+        appendLe<quint32>(body, msg.id | ((msg.id > 0x7FF) ? 0x80000000 : 0));
+        body.append(reinterpret_cast<const char *>(msg.data.data()),
+                    CAN_MAX_DLC);
+        return blfObject(86, 32, body);
+    }
+
+    static QByteArray blfContainer(const QByteArray &data, bool compress)
+    {
+        QByteArray body{};
+        appendLe<quint16>(body, compress ? 2 : 0);
+        appendLe<quint16>(body, 0);
+        appendLe<quint32>(body, 0);
+        appendLe<quint32>(body, data.size());
+        appendLe<quint32>(body, 0);
+        // qCompress puts the size in front of the zlib stream
+        body.append(compress ? qCompress(data).mid(4) : data);
+        return blfObject(10, 16, body);
+    }
+
+    /* File holding objects in containers cut at the given offsets */
+    static QByteArray blfFile(const QByteArray &objects,
+                              QVector<qsizetype> cuts)
+    {
+        QByteArray file("LOGG");
+        appendLe<quint32>(file, 144);
+        file.append(QByteArray(16, '\0'));
+        appendLe<quint64>(file, objects.size());
+        file.append(QByteArray(144 - file.size(), '\0'));
+        cuts.append(objects.size());
+        qsizetype begin = 0;
+        for (qsizetype i = 0; i < cuts.size(); i++) {
+            file.append(blfContainer(objects.mid(begin, cuts[i] - begin),
+                                     i % 3 != 1));
+            begin = cuts[i];
+        }
+        return file;
+    }
+
+private slots:
+    void testAsc()
+    {
+        QByteArray text =
+                "date Wed May 19 04:53:34 pm 2023\n"
+                "base hex  timestamps absolute\n"
+                "   0.006990 1  100             Rx   d 8 01 02 03 04 05 06 "
+                "07 08  Length = 228000 BitCount = 118 ID = 256\n"
+                "   1.500000 2  18FEF100x       Tx   d 3 AA BB CC\n"
+                "   2.250000 1  123             Rx   r\n";
+        auto log = parseText(text, "asc");
+        QCOMPARE(log.size(), 2);
+        QCOMPARE(log.at(0).number, 0);
+        QCOMPARE(log.at(0).time, 0.00699);
+        QCOMPARE(log.at(0).channel, 1);
+        QCOMPARE(log.at(0).id, 0x100);
+        QCOMPARE(log.at(0).dir, static_cast<uint8_t>(CAN_DIR_RX));
+        QCOMPARE(log.at(0).dlc, 8);
+        QCOMPARE(log.at(0).data[7], 0x08);
+        QCOMPARE(log.at(1).number, 1);
+        QCOMPARE(log.at(1).channel, 2);
+        QCOMPARE(log.at(1).id, 0x18FEF100);
+        QCOMPARE(log.at(1).dir, static_cast<uint8_t>(CAN_DIR_TX));
+        QCOMPARE(log.at(1).dlc, 3);
+        QCOMPARE(log.at(1).data[2], 0xCC);
+        QCOMPARE(log.at(1).data[3], 0x00);
+    }
+
+    void testAscTimeRounding()
+    {
+        // A sum of integer and fraction would round this one down
+        QByteArray text = "base hex  timestamps absolute\n"
+                          "  57.727487 1  100             Rx   d 1 01\n";
+        auto log = parseText(text, "asc");
+        QCOMPARE(log.size(), 1);
+        QVERIFY(log.at(0).time == QByteArray("57.727487").toDouble());
+    }
+
+    void testAscChunks()
+    {
+        QByteArray text = "date Wed May 19 04:53:34 pm 2023\n"
+                          "base hex  timestamps absolute\n";
+        for (int i = 0; i < 40; i++) {
+            auto line = QString::asprintf("%11.6f %d  %X%s  %s   d %d",
+                                          0.25 * i, 1 + i % 2,
+                                          (i % 3 == 0) ? 0x18FEF100 + i
+                                                       : 0x100 + i,
+                                          (i % 3 == 0) ? "x" : "",
+                                          (i % 4 == 0) ? "Tx" : "Rx", i % 9);
+            for (int b = 0; b < i % 9; b++) {
+                line += QString::asprintf(" %02X", i + b);
+            }
+            text += line.toUtf8() + "\n";
+            if (i % 7 == 0) {
+                text += "   1.000000 1  Statistic: D 0 R 0\n";
+            }
+        }
+
+        auto whole = parseText(text, "asc");
+        QCOMPARE(whole.size(), 40);
+        // Chunks of one line, cut in the middle of lines, of a few lines
+        for (qsizetype chunkSize : { 1, 50, 333 }) {
+            auto log = parseText(text, "asc", chunkSize);
+            QCOMPARE(log.size(), whole.size());
+            for (qsizetype i = 0; i < log.size(); i++) {
+                auto msg = log.at(i);
+                auto expected = whole.at(i);
+                QCOMPARE(msg.number, static_cast<uint32_t>(i));
+                QCOMPARE(msg.time, expected.time);
+                QCOMPARE(msg.channel, expected.channel);
+                QCOMPARE(msg.id, expected.id);
+                QCOMPARE(msg.dir, expected.dir);
+                QCOMPARE(msg.dlc, expected.dlc);
+                QVERIFY(msg.data == expected.data);
+            }
+        }
+    }
+
+    void testBlfSplitObjects()
+    {
+        QVector<CanLogMsg> frames{};
+        QVector<qsizetype> starts{};
+        QByteArray objects{};
+        for (uint32_t i = 0; i < 12; i++) {
+            CanLogMsg msg;
+            msg.number = i;
+            msg.channel = 1 + i % 2;
+            msg.id = (i % 3 == 0) ? 0x18FEF100 + i : 0x100 + i;
+            msg.dlc = i % 9;
+            for (int b = 0; b < CAN_MAX_DLC; b++) {
+                msg.data[b] = static_cast<uint8_t>(i * 16 + b);
+            }
+            if (i == 5) {
+                // A signature in the payload, cut off from its object
+                std::memcpy(msg.data.data(), "LOBJ", 4);
+            }
+            quint64 timestamp = 1000000 * i + 7;
+            msg.time = 1e-9 * timestamp;
+            frames.append(msg);
+            starts.append(objects.size());
+            objects.append(blfCanMessage(msg, timestamp));
+            if (i == 2) {
+                // Not a frame, padded to 4 bytes
+                objects.append(blfObject(65, 32, QByteArray(22, 'x')));
+            }
+        }
+
+        /* Cuts in a signature, in a padded object, in a header, before the
+         * payload of frame 5, twice in frame 7 and on an object border */
+        auto log = parseText(blfFile(objects,
+                                     { starts[1] + 2, starts[3] - 10,
+                                       starts[3] + 10,
+                                       starts[5] + 38, starts[7] + 20,
+                                       starts[7] + 30, starts[9] }),
+                             "blf");
+        // One container, nothing to stitch
+        auto whole = parseText(blfFile(objects, {}), "blf");
+        QCOMPARE(whole.size(), frames.size());
+        QCOMPARE(log.size(), frames.size());
+        for (qsizetype i = 0; i < frames.size(); i++) {
+            for (const auto &parsed : { log.at(i), whole.at(i) }) {
+                QCOMPARE(parsed.number, frames[i].number);
+                QCOMPARE(parsed.time, frames[i].time);
+                QCOMPARE(parsed.channel, frames[i].channel);
+                QCOMPARE(parsed.id, frames[i].id);
+                QCOMPARE(parsed.dlc, frames[i].dlc);
+                QVERIFY(parsed.data == frames[i].data);
+            }
+        }
+    }
+
+    void testTrc()
+    {
+        QByteArray text =
+                ";$FILEVERSION=1.1\r\n"
+                ";   Message Number\r\n"
+                "\r\n"
+                "     1)    118912.2  Rx     0CF00300  8  03 00 00 00 00 00 "
+                "00 00\r\n"
+                "     2)    118912.5  Tx     18F00010  2  00 7D\r\n";
+        auto log = parseText(text, "trc");
+        QCOMPARE(log.size(), 2);
+        QCOMPARE(log.at(0).number, 1);
+        QCOMPARE(log.at(0).time, 118.9122);
+        QCOMPARE(log.at(0).id, 0x0CF00300);
+        QCOMPARE(log.at(0).data[0], 0x03);
+        QCOMPARE(log.at(1).number, 2);
+        QCOMPARE(log.at(1).dir, static_cast<uint8_t>(CAN_DIR_TX));
+        QCOMPARE(log.at(1).dlc, 2);
+        QCOMPARE(log.at(1).data[1], 0x7D);
+    }
+};
+
+QTEST_MAIN(TestLogParser)
+#include "testlogparser.moc"
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <QTest>
+#include "framestore.h"
+#include "payloadsearch.h"
+
+class TestPayloadSearch : public QObject
+{
+    Q_OBJECT
+private slots:
+    void find()
+    {
+        FrameStore frames;
+        // Crosses a block edge and leaves vector tails in both blocks
+        auto count = FrameStore::blockSize + 7;
+        for (qsizetype i = 0; i < count; i++) {
+            CanLogMsg frame;
+            frame.id = (i % 2 == 0) ? 0x100 : 0x200;
+            frame.channel = (i % 3 == 0) ? 1 : 2;
+            frame.dlc = (i == 40) ? 3 : CAN_MAX_DLC;
+            frame.data = { 0x12, static_cast<uint8_t>(i), 0x34, 0xFF };
+            if (i % 10 != 0) {
+                frame.data[3] = 0;
+            }
+            frames.append(frame);
+        }
+
+        auto search = PayloadSearch::compile("12 ?? 3? FF");
+        auto hits = search.find(frames);
+        // Every tenth frame from 0 on, less the short frame 40
+        QCOMPARE(hits.size(), count / 10);
+        QCOMPARE(hits.first(), 0u);
+        QCOMPARE(hits.at(4), 50u);
+        QVERIFY(std::is_sorted(hits.cbegin(), hits.cend()));
+
+        search = PayloadSearch::compile("12??34FF");
+        search.setChannel(1);
+        hits = search.find(frames);
+        QCOMPARE(hits.first(), 0u);
+        QCOMPARE(hits.at(1), 30u);
+
+        search = PayloadSearch::compile("?? 05");
+        search.setId(0x200);
+        hits = search.find(frames);
+        QCOMPARE(hits.first(), 5u);
+        QCOMPARE(hits.at(1), 5u + 256);
+    }
+
+    void errors()
+    {
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 PayloadSearch::compile(""));
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 PayloadSearch::compile("123"));
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error,
+                                 PayloadSearch::compile("1G"));
+        QVERIFY_THROWS_EXCEPTION(
+                std::runtime_error,
+                PayloadSearch::compile("00 11 22 33 44 55 66 77 88"));
+    }
+};
+
+QTEST_MAIN(TestPayloadSearch)
+#include "testpayloadsearch.moc"
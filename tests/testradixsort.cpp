@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <QTest>
+#include "radixsort.h"
+
+class TestRadixSort : public QObject
+{
+    Q_OBJECT
+private:
+    static void check(std::vector<uint64_t> keys)
+    {
+        std::vector<uint32_t> rows(keys.size());
+        std::iota(rows.begin(), rows.end(), 0);
+        auto expected = rows;
+        std::stable_sort(expected.begin(), expected.end(),
+                         [&](uint32_t a, uint32_t b) {
+                             return keys[a] < keys[b];
+                         });
+        auto sortedKeys = keys;
+        RadixSort::sort(sortedKeys, rows);
+        QCOMPARE(rows, expected);
+        QVERIFY(std::is_sorted(sortedKeys.cbegin(), sortedKeys.cend()));
+    }
+
+private slots:
+    void sort()
+    {
+        check({});
+        check({ 42 });
+        check({ 3, 1, 2, 1, 3, 0 });
+
+        // Enough keys for several chunks, with many ties to keep in order
+        std::mt19937_64 random(1);
+        std::vector<uint64_t> keys(300000);
+        for (auto &key : keys) {
+            key = random() % 0x800;
+        }
+        check(keys);
+        for (auto &key : keys) {
+            key = random();
+        }
+        check(keys);
+    }
+};
+
+QTEST_MAIN(TestRadixSort)
+#include "testradixsort.moc"
@@ -0,0 +1,146 @@
+#include <QTest>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include "tracecache.h"
+
+class TestTraceCache : public QObject
+{
+    Q_OBJECT
+private:
+    QTemporaryDir dir{};
+    QString source{};
+
+    static FrameStore makeFrames()
+    {
+        FrameStore frames;
+        // A partial last block checks the padding
+        auto count = FrameStore::blockSize + 777;
+        for (qsizetype i = 0; i < count; i++) {
+            CanLogMsg frame;
+            frame.number = static_cast<uint32_t>(i);
+            frame.time = static_cast<double>(i) * 0.001;
+            frame.id = (i % 3 == 0) ? 0x18FEF100 : 0x100;
+            frame.channel = static_cast<uint8_t>(1 + (i % 2));
+            frame.dlc = static_cast<uint8_t>(i % 9);
+            frame.dir = static_cast<uint8_t>(i % 2);
+            frame.data[0] = static_cast<uint8_t>(i);
+            frame.data[7] = static_cast<uint8_t>(i >> 8);
+            frames.append(frame);
+        }
+        return frames;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        source = dir.filePath("trace.asc");
+        QFile file(source);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("base hex  timestamps absolute\n");
+    }
+
+    void roundTrip()
+    {
+        QVERIFY(!TraceCache::load(source).has_value());
+        auto frames = makeFrames();
+        QVERIFY(TraceCache::save(source, frames));
+        auto cached = TraceCache::load(source);
+        QVERIFY(cached.has_value());
+        QCOMPARE(cached->size(), frames.size());
+        QCOMPARE(cached->blockCount(), frames.blockCount());
+        for (qsizetype row = 0; row < frames.size(); row += 997) {
+            auto expected = frames.at(row);
+            auto actual = cached->at(row);
+            QCOMPARE(actual.number, expected.number);
+            QCOMPARE(actual.time, expected.time);
+            QCOMPARE(actual.id, expected.id);
+            QCOMPARE(actual.channel, expected.channel);
+            QCOMPARE(actual.dlc, expected.dlc);
+            QCOMPARE(actual.dir, expected.dir);
+            QCOMPARE(actual.data, expected.data);
+        }
+        QCOMPARE(cached->frameKeys().size(), frames.frameKeys().size());
+        QCOMPARE(cached->rows(2, 0x100), frames.rows(2, 0x100));
+        QCOMPARE(cached->rowsOfId(0x18FEF100), frames.rowsOfId(0x18FEF100));
+        QCOMPARE(cached->rowAtTime(65.5), frames.rowAtTime(65.5));
+
+        // Appending copies the mapped tail block first
+        CanLogMsg frame;
+        frame.time = 1000;
+        auto grown = *cached;
+        grown.append(frame);
+        QCOMPARE(grown.size(), frames.size() + 1);
+        QCOMPARE(grown.time(frames.size()), 1000.0);
+        QCOMPARE(grown.at(frames.size() - 1).number,
+                 frames.at(frames.size() - 1).number);
+    }
+
+    void corrupt()
+    {
+        QVERIFY(TraceCache::save(source, makeFrames()));
+        QFile cache(TraceCache::cachePath(source));
+        QVERIFY(cache.open(QFile::ReadWrite));
+        QVERIFY(cache.seek(200));
+        auto byte = cache.read(1);
+        byte[0] = static_cast<char>(byte.at(0) ^ 1);
+        QVERIFY(cache.seek(200));
+        cache.write(byte);
+        cache.close();
+        QVERIFY(!TraceCache::load(source).has_value());
+
+        // Halfway through the file is block data
+        QVERIFY(TraceCache::save(source, makeFrames()));
+        QVERIFY(cache.open(QFile::ReadWrite));
+        auto middle = cache.size() / 2;
+        QVERIFY(cache.seek(middle));
+        byte = cache.read(1);
+        byte[0] = static_cast<char>(byte.at(0) ^ 1);
+        QVERIFY(cache.seek(middle));
+        cache.write(byte);
+        cache.close();
+        QVERIFY(!TraceCache::load(source).has_value());
+
+        QVERIFY(TraceCache::save(source, makeFrames()));
+        QVERIFY(cache.resize(cache.size() - 8));
+        QVERIFY(!TraceCache::load(source).has_value());
+    }
+
+    void prune()
+    {
+        auto other = dir.filePath("other.asc");
+        QFile file(other);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("base hex  timestamps absolute\n");
+        file.close();
+        QVERIFY(TraceCache::save(source, makeFrames()));
+        QVERIFY(TraceCache::save(other, makeFrames()));
+
+        // The cache of source was used last
+        QFile older(TraceCache::cachePath(other));
+        QVERIFY(older.open(QFile::Append));
+        QVERIFY(older.setFileTime(QDateTime::currentDateTime().addSecs(-60),
+                                  QFileDevice::FileModificationTime));
+        older.close();
+        TraceCache::prune(QFileInfo(TraceCache::cachePath(source)).size());
+        QVERIFY(QFile::exists(TraceCache::cachePath(source)));
+        QVERIFY(!QFile::exists(TraceCache::cachePath(other)));
+    }
+
+    void stale()
+    {
+        QVERIFY(TraceCache::save(source, makeFrames()));
+        QVERIFY(TraceCache::load(source).has_value());
+        QFile file(source);
+        QVERIFY(file.open(QFile::Append));
+        file.write("\n");
+        file.close();
+        QVERIFY(!TraceCache::load(source).has_value());
+    }
+};
+
+QTEST_MAIN(TestTraceCache)
+#include "testtracecache.moc"
@@ -0,0 +1,78 @@
+#include <cmath>
+#include <QTest>
+#include "framestore.h"
+#include "tracestats.h"
+
+class TestTraceStats : public QObject
+{
+    Q_OBJECT
+private slots:
+    void compute()
+    {
+        FrameStore frames;
+        // Spans two blocks so partials of both get merged
+        auto count = FrameStore::blockSize + 100;
+        for (qsizetype i = 0; i < count; i++) {
+            CanLogMsg frame;
+            frame.time = static_cast<double>(i) * 0.005;
+            if (i % 2 == 0) {
+                frame.id = 0x100;
+                frame.channel = 1;
+            } else if ((i % 6 == 1) || (i % 6 == 3)) {
+                // Periods of 10 and 20 ms, in turn
+                frame.id = 0x18FEF100;
+                frame.channel = 2;
+                frame.dlc = (i % 6 == 1) ? 4 : 8;
+                frame.dir = CAN_DIR_TX;
+            } else {
+                frame.id = 0x100;
+                frame.channel = 2;
+            }
+            frames.append(frame);
+        }
+
+        auto stats = TraceStats::compute(frames);
+        QCOMPARE(stats.size(), 3);
+        QCOMPARE(stats.at(0).channel, 1);
+        QCOMPARE(stats.at(1).id, 0x100u);
+        QCOMPARE(stats.at(2).id, 0x18FEF100u);
+
+        for (const auto &item : stats) {
+            // Reference from the posting list, one frame after the other
+            auto rows = frames.rows(item.channel, item.id);
+            QCOMPARE(item.count, static_cast<quint64>(rows.size()));
+            QCOMPARE(item.firstTime, frames.time(rows.first()));
+            QCOMPARE(item.lastTime, frames.time(rows.last()));
+            double sum = 0;
+            double minPeriod = qInf();
+            double maxPeriod = -qInf();
+            for (qsizetype i = 1; i < rows.size(); i++) {
+                auto period = frames.time(rows.at(i)) - frames.time(rows.at(i - 1));
+                sum += period;
+                minPeriod = std::min(minPeriod, period);
+                maxPeriod = std::max(maxPeriod, period);
+            }
+            auto mean = sum / static_cast<double>(rows.size() - 1);
+            double squares = 0;
+            for (qsizetype i = 1; i < rows.size(); i++) {
+                auto period = frames.time(rows.at(i)) - frames.time(rows.at(i - 1));
+                squares += (period - mean) * (period - mean);
+            }
+            auto jitter = std::sqrt(squares / static_cast<double>(rows.size() - 1));
+            QVERIFY(std::abs(item.meanPeriod - mean) < 1e-9);
+            QVERIFY(std::abs(item.jitter - jitter) < 1e-9);
+            QCOMPARE(item.minPeriod, minPeriod);
+            QCOMPARE(item.maxPeriod, maxPeriod);
+        }
+
+        const auto &ext = stats.at(2);
+        QCOMPARE(ext.txCount, ext.count);
+        QCOMPARE(ext.rxCount(), 0u);
+        QCOMPARE(ext.dlcMask, (1 << 4) | (1 << 8));
+        QVERIFY(std::abs(ext.jitter - 0.005) < 1e-6);
+        QCOMPARE(stats.at(0).dlcMask, 1 << CAN_MAX_DLC);
+    }
+};
+
+QTEST_MAIN(TestTraceStats)
+#include "testtracestats.moc"